@@ -0,0 +1,161 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_BOOT_REPORT
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_matter_console.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs.h>
+
+#include <platform/CHIPDeviceLayer.h>
+
+#include <app_boot.h>
+
+static const char *TAG = "app_boot";
+
+static constexpr const char *kNvsNamespace = "app_boot";
+static constexpr const char *kNvsKey = "report";
+// Bump when the report layout changes, older reports are then ignored.
+static constexpr uint8_t kReportVersion = 1;
+
+static constexpr const char *kPhaseNames[APP_BOOT_PHASE_MAX] = {
+    "app_main", "nvs", "node", "switches", "platform", "matter_start",
+    "server_ready", "fabric_ready", "first_press", "first_command",
+};
+
+typedef struct {
+    uint8_t version;
+    uint8_t reset_reason;
+    // Microseconds since boot, 0 when the phase wasn't reached.
+    uint32_t time_us[APP_BOOT_PHASE_MAX];
+} boot_report_t;
+
+static std::atomic<uint32_t> s_time_us[APP_BOOT_PHASE_MAX];
+static boot_report_t s_last;
+static bool s_last_valid = false;
+
+static void app_boot_save(intptr_t arg)
+{
+    boot_report_t report = {};
+    report.version = kReportVersion;
+    report.reset_reason = static_cast<uint8_t>(esp_reset_reason());
+    for (size_t i = 0; i < APP_BOOT_PHASE_MAX; i++) {
+        report.time_us[i] = s_time_us[i].load(std::memory_order_relaxed);
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(kNvsNamespace, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, kNvsKey, &report, sizeof(report));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save boot report, err:%d", err);
+    }
+}
+
+esp_err_t app_boot_init()
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(kNvsNamespace, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // First boot, nothing saved yet.
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t size = sizeof(s_last);
+    err = nvs_get_blob(handle, kNvsKey, &s_last, &size);
+    nvs_close(handle);
+    s_last_valid = err == ESP_OK && size == sizeof(s_last) && s_last.version == kReportVersion;
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+}
+
+void app_boot_mark(app_boot_phase_t phase)
+{
+    if (phase >= APP_BOOT_PHASE_MAX) {
+        return;
+    }
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    uint32_t unset = 0;
+    if (!s_time_us[phase].compare_exchange_strong(unset, now ? now : 1, std::memory_order_relaxed)) {
+        return;
+    }
+
+    // Saved once per boot, when the report is complete, to keep flash wear off every boot
+    // phase. A boot that never gets to a command leaves the previous report in place.
+    if (phase == APP_BOOT_FIRST_COMMAND) {
+        if (chip::DeviceLayer::PlatformMgr().ScheduleWork(app_boot_save) != CHIP_NO_ERROR) {
+            ESP_LOGW(TAG, "Failed to schedule boot report save");
+        }
+    }
+}
+
+static void app_boot_print(const uint32_t *time_us)
+{
+    uint32_t previous = 0;
+    for (size_t i = 0; i < APP_BOOT_PHASE_MAX; i++) {
+        if (time_us[i] == 0) {
+            printf("%-14s -\n", kPhaseNames[i]);
+        } else if (i < APP_BOOT_FIRST_PRESS) {
+            printf("%-14s %8lu ms  +%lu ms\n", kPhaseNames[i], time_us[i] / 1000, (time_us[i] - previous) / 1000);
+            previous = time_us[i];
+        } else {
+            // A press can come in at any point of the startup, so it has no place in the sequence.
+            printf("%-14s %8lu ms\n", kPhaseNames[i], time_us[i] / 1000);
+        }
+    }
+}
+
+static esp_err_t app_boot_console_handler(int argc, char **argv)
+{
+    if (argc == 0 || strcmp(argv[0], "now") == 0) {
+        uint32_t time_us[APP_BOOT_PHASE_MAX];
+        for (size_t i = 0; i < APP_BOOT_PHASE_MAX; i++) {
+            time_us[i] = s_time_us[i].load(std::memory_order_relaxed);
+        }
+        printf("reset reason %d\n", static_cast<int>(esp_reset_reason()));
+        app_boot_print(time_us);
+    } else if (strcmp(argv[0], "last") == 0) {
+        if (!s_last_valid) {
+            printf("No report from the previous boot\n");
+            return ESP_OK;
+        }
+        printf("reset reason %u\n", s_last.reset_reason);
+        app_boot_print(s_last.time_us);
+    } else {
+        ESP_LOGE(TAG, "Usage: boot [now|last]");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_boot_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "boot",
+        .description = "Boot phase timestamps. Usage: matter esp boot [now|last]",
+        .handler = app_boot_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
+
+#endif // CONFIG_DIMMER_SWITCH_BOOT_REPORT
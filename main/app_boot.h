@@ -0,0 +1,74 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+#include <stdint.h>
+
+/* Boot phase timestamps.
+ *
+ * Each phase of startup is stamped once with esp_timer_get_time() when it is first reached,
+ * up to the first command a light acknowledges. The report is saved to NVS as the later phases
+ * come in, so the breakdown of the previous boot can still be read after the next power cut. */
+
+typedef enum : uint8_t {
+    APP_BOOT_APP_MAIN = 0,
+    APP_BOOT_NVS,
+    APP_BOOT_NODE,
+    APP_BOOT_SWITCHES,
+    APP_BOOT_PLATFORM,
+    APP_BOOT_MATTER_START,
+    APP_BOOT_SERVER_READY,
+    APP_BOOT_FABRIC_READY,
+    APP_BOOT_FIRST_PRESS,
+    APP_BOOT_FIRST_COMMAND,
+    APP_BOOT_PHASE_MAX,
+} app_boot_phase_t;
+
+#if CONFIG_DIMMER_SWITCH_BOOT_REPORT
+
+/** Load the report of the previous boot
+ *
+ * Must be called after nvs_flash_init().
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_boot_init();
+
+/** Stamp a phase
+ *
+ * Only the first call for a phase is kept. Safe to call from any task. Reaching the server,
+ * fabric and first command phases schedules a save of the report in the Matter thread.
+ *
+ * @param[in] phase Phase reached.
+ */
+void app_boot_mark(app_boot_phase_t phase);
+
+/** Register the `boot` console command
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_boot_register_commands();
+
+#else
+
+static inline esp_err_t app_boot_init()
+{
+    return ESP_OK;
+}
+static inline void app_boot_mark(app_boot_phase_t phase) {}
+static inline esp_err_t app_boot_register_commands()
+{
+    return ESP_OK;
+}
+
+#endif // CONFIG_DIMMER_SWITCH_BOOT_REPORT
@@ -0,0 +1,215 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <esp_matter.h>
+#include <esp_matter_client.h>
+#include <stdlib.h>
+
+#include <app/server/Server.h>
+#include <controller/InvokeInteraction.h>
+#include <lib/core/ScopedNodeId.h>
+
+/** Called when a unicast invoke has been acknowledged by the peer
+ *
+ * Implemented by the driver. Runs in the Matter thread.
+ *
+ * @param[in] peer Node and fabric the command was sent to.
+ * @param[in] sequence Sequence number the command was sent with.
+ * @param[in] command_path Path of the command that succeeded.
+ */
+void app_command_success_cb(const chip::ScopedNodeId &peer, uint16_t sequence,
+                            const chip::app::ConcreteCommandPath &command_path);
+
+/** Called when a unicast invoke failed or was rejected by the peer
+ *
+ * Implemented by the driver. Runs in the Matter thread.
+ *
+ * @param[in] peer Node and fabric the command was sent to.
+ * @param[in] sequence Sequence number the command was sent with.
+ * @param[in] cluster_id Cluster of the command that failed.
+ * @param[in] command_id Command that failed.
+ * @param[in] error Transport error or the status returned by the peer.
+ */
+void app_command_failure_cb(const chip::ScopedNodeId &peer, uint16_t sequence, chip::ClusterId cluster_id,
+                            chip::CommandId command_id, CHIP_ERROR error);
+
+/** Send a typed command over an established session
+ *
+ * The command struct is encoded straight into the invoke request TLV, so no
+ * intermediate JSON is formatted or parsed. Must be called with the Matter
+ * stack lock held, which is the case inside the client request callbacks.
+ *
+ * @param[in] exchange_mgr Exchange manager of the session.
+ * @param[in] session CASE session to the peer.
+ * @param[in] node_id Peer the session leads to, reported to the completion callbacks.
+ * @param[in] endpoint_id Remote endpoint the command is addressed to.
+ * @param[in] command Command struct, e.g. `LevelControl::Commands::Step::Type`.
+ * @param[in] timeout Response timeout, or NullOptional for the stack default.
+ * @param[in] sequence Tag handed back to the completion callbacks, 0 for untracked sends.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+template <typename CommandType>
+esp_err_t app_command_send(chip::Messaging::ExchangeManager *exchange_mgr, const chip::SessionHandle &session,
+                           chip::NodeId node_id, chip::EndpointId endpoint_id, const CommandType &command,
+                           const chip::Optional<chip::System::Clock::Timeout> &timeout = chip::NullOptional,
+                           uint16_t sequence = 0)
+{
+    chip::ClusterId cluster_id = CommandType::GetClusterId();
+    chip::CommandId command_id = CommandType::GetCommandId();
+    chip::ScopedNodeId peer(node_id, session->GetFabricIndex());
+    auto on_success = [peer, sequence](const chip::app::ConcreteCommandPath &command_path,
+                                       const chip::app::StatusIB &status,
+                                       const typename CommandType::ResponseType &response) {
+        app_command_success_cb(peer, sequence, command_path);
+    };
+    auto on_failure = [peer, sequence, cluster_id, command_id](CHIP_ERROR error) {
+        app_command_failure_cb(peer, sequence, cluster_id, command_id, error);
+    };
+
+    CHIP_ERROR err = chip::Controller::InvokeCommandRequest(exchange_mgr, session, endpoint_id, command, on_success,
+                                                            on_failure, chip::NullOptional, timeout);
+    return err == CHIP_NO_ERROR ? ESP_OK : ESP_FAIL;
+}
+
+/** Send a typed command to a single peer
+ *
+ * @param[in] peer_device Peer with an established CASE session.
+ * @param[in] endpoint_id Remote endpoint the command is addressed to.
+ * @param[in] command Command struct, e.g. `LevelControl::Commands::Step::Type`.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+template <typename CommandType>
+esp_err_t app_command_send(esp_matter::client::peer_device_t *peer_device, chip::EndpointId endpoint_id,
+                           const CommandType &command)
+{
+    chip::Optional<chip::SessionHandle> session = peer_device->GetSecureSession();
+    if (!session.HasValue()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return app_command_send(peer_device->GetExchangeManager(), session.Value(), peer_device->GetDeviceId(),
+                            endpoint_id, command);
+}
+
+/** Send a typed command to a group
+ *
+ * Group invokes are unacknowledged, so no completion callback is raised. Must
+ * be called with the Matter stack lock held.
+ *
+ * @param[in] fabric_index Fabric the group belongs to.
+ * @param[in] group_id Destination group.
+ * @param[in] command Command struct, e.g. `OnOff::Commands::Toggle::Type`.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+template <typename CommandType>
+esp_err_t app_command_send_group(chip::FabricIndex fabric_index, chip::GroupId group_id, const CommandType &command)
+{
+    CHIP_ERROR err = chip::Controller::InvokeGroupCommandRequest(&chip::Server::GetInstance().GetExchangeManager(),
+                                                                 fabric_index, group_id, command);
+    return err == CHIP_NO_ERROR ? ESP_OK : ESP_FAIL;
+}
+
+/** Resolve a client request to its typed command and hand it to a sender
+ *
+ * The command struct is selected from the request's cluster and command IDs at
+ * compile time; `request_data` must point at the matching `Type` for commands
+ * that carry fields. Identify is the exception: it keeps the client console
+ * format, a parameter count byte that must be 1 followed by the identify time
+ * as a NUL terminated hex string. `send` is a generic callable taking the
+ * command struct, typically forwarding to app_command_send() or
+ * app_command_send_group().
+ *
+ * @param[in] req_handle Request passed to the client request callback.
+ * @param[in] send Sender invoked with the typed command.
+ *
+ * @return result of `send`.
+ * @return ESP_ERR_NOT_SUPPORTED if the command is not one the switch sends.
+ */
+template <typename Sender>
+esp_err_t app_command_dispatch(const esp_matter::client::request_handle_t *req_handle, Sender &&send)
+{
+    using namespace chip::app::Clusters;
+
+    const void *data = req_handle->request_data;
+    switch (req_handle->command_path.mClusterId) {
+    case OnOff::Id:
+        switch (req_handle->command_path.mCommandId) {
+        case OnOff::Commands::Off::Id:
+            return send(OnOff::Commands::Off::Type());
+        case OnOff::Commands::On::Id:
+            return send(OnOff::Commands::On::Type());
+        case OnOff::Commands::Toggle::Id:
+            return send(OnOff::Commands::Toggle::Type());
+        default:
+            break;
+        }
+        break;
+
+    case LevelControl::Id:
+        if (data == nullptr) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        switch (req_handle->command_path.mCommandId) {
+        case LevelControl::Commands::Step::Id:
+            return send(*static_cast<const LevelControl::Commands::Step::Type *>(data));
+        case LevelControl::Commands::Move::Id:
+            return send(*static_cast<const LevelControl::Commands::Move::Type *>(data));
+        case LevelControl::Commands::Stop::Id:
+            return send(*static_cast<const LevelControl::Commands::Stop::Type *>(data));
+        case LevelControl::Commands::MoveToLevelWithOnOff::Id:
+            return send(*static_cast<const LevelControl::Commands::MoveToLevelWithOnOff::Type *>(data));
+        default:
+            break;
+        }
+        break;
+
+    case ScenesManagement::Id:
+        if (data == nullptr) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        switch (req_handle->command_path.mCommandId) {
+        case ScenesManagement::Commands::RecallScene::Id:
+            return send(*static_cast<const ScenesManagement::Commands::RecallScene::Type *>(data));
+        default:
+            break;
+        }
+        break;
+
+    case Identify::Id:
+        if (data == nullptr) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        switch (req_handle->command_path.mCommandId) {
+        case Identify::Commands::Identify::Id: {
+            // Identify comes from the client console, which passes its arguments as text.
+            const char *args = static_cast<const char *>(data);
+            if (args[0] != 1) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            Identify::Commands::Identify::Type command;
+            command.identifyTime = static_cast<uint16_t>(strtoul(args + 1, nullptr, 16));
+            return send(command);
+        }
+        default:
+            break;
+        }
+        break;
+
+    default:
+        break;
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,170 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Dimming curves give the size of the Step sent on each long press hold tick. The linear
+ * and accelerating curves are indexed by the tick; the perceptual curve by the level the
+ * lights are at, so a hold that starts mid-range takes the step that fits that level. Every
+ * curve is a lookup table built at compile time, so the button callback only indexes an
+ * array. */
+
+typedef enum {
+    /* Same step on every tick */
+    DIMMING_CURVE_LINEAR = 0,
+    /* Each step moves the same distance in perceived brightness, with level following a cubic of
+     * lightness: fine at the low end, coarse at the top */
+    DIMMING_CURVE_PERCEPTUAL,
+    /* Steps grow the longer the button is held */
+    DIMMING_CURVE_ACCELERATING,
+    DIMMING_CURVE_MAX,
+} app_dimming_curve_t;
+
+static constexpr size_t kDimmingCurveLength = 32;
+static constexpr uint32_t kDimmingMaxLevel = 254;
+static constexpr uint8_t kDimmingLinearStep = 3;
+
+typedef struct {
+    uint8_t steps[kDimmingCurveLength];
+} app_dimming_curve_table_t;
+
+constexpr app_dimming_curve_table_t app_dimming_curve_make_linear()
+{
+    app_dimming_curve_table_t table = {};
+    for (size_t i = 0; i < kDimmingCurveLength; i++) {
+        table.steps[i] = kDimmingLinearStep;
+    }
+    return table;
+}
+
+/* The perceptual curve splits lightness into kDimmingCurveLength steps, each cut into
+ * kDimmingPerceptualFraction fractions so a level between two steps finds its place. */
+static constexpr uint32_t kDimmingPerceptualFraction = 16;
+static constexpr uint32_t kDimmingPerceptualPositions = kDimmingCurveLength * kDimmingPerceptualFraction;
+
+typedef struct {
+    uint8_t up[kDimmingMaxLevel + 1];
+    uint8_t down[kDimmingMaxLevel + 1];
+} app_dimming_perceptual_table_t;
+
+/* Level at a position on the perceptual curve */
+constexpr uint32_t app_dimming_curve_perceptual_level(uint32_t position)
+{
+    return static_cast<uint32_t>(static_cast<uint64_t>(kDimmingMaxLevel) * position * position * position /
+                                 (static_cast<uint64_t>(kDimmingPerceptualPositions) * kDimmingPerceptualPositions *
+                                  kDimmingPerceptualPositions));
+}
+
+constexpr app_dimming_perceptual_table_t app_dimming_curve_make_perceptual()
+{
+    app_dimming_perceptual_table_t table = {};
+    uint32_t position = 0;
+    for (uint32_t level = 0; level <= kDimmingMaxLevel; level++) {
+        while (position < kDimmingPerceptualPositions && app_dimming_curve_perceptual_level(position + 1) <= level) {
+            position++;
+        }
+        // One step of lightness above and below the level.
+        uint32_t above = position + kDimmingPerceptualFraction;
+        above = above < kDimmingPerceptualPositions ? above : kDimmingPerceptualPositions;
+        uint32_t below = position > kDimmingPerceptualFraction ? position - kDimmingPerceptualFraction : 0;
+        uint32_t up = app_dimming_curve_perceptual_level(above) - level;
+        uint32_t down = level - app_dimming_curve_perceptual_level(below);
+        table.up[level] = up < 1 ? 1 : static_cast<uint8_t>(up);
+        table.down[level] = down < 1 ? 1 : static_cast<uint8_t>(down);
+    }
+    return table;
+}
+
+constexpr app_dimming_curve_table_t app_dimming_curve_make_accelerating()
+{
+    app_dimming_curve_table_t table = {};
+    for (size_t i = 0; i < kDimmingCurveLength; i++) {
+        table.steps[i] = static_cast<uint8_t>(2 + i);
+    }
+    return table;
+}
+
+/* Number of hold ticks a curve takes to sweep the full level range */
+constexpr size_t app_dimming_curve_sweep_ticks(const app_dimming_curve_table_t &table)
+{
+    uint32_t level = 0;
+    size_t ticks = 0;
+    while (level < kDimmingMaxLevel) {
+        level += table.steps[ticks < kDimmingCurveLength ? ticks : kDimmingCurveLength - 1];
+        ticks++;
+    }
+    return ticks;
+}
+
+/* Number of hold ticks the perceptual curve takes to sweep the full level range */
+constexpr size_t app_dimming_curve_perceptual_sweep_ticks(const app_dimming_perceptual_table_t &table, bool up)
+{
+    uint32_t level = up ? 0 : kDimmingMaxLevel;
+    size_t ticks = 0;
+    while (up ? level < kDimmingMaxLevel : level > 1) {
+        level = up ? level + table.up[level] : (level > table.down[level] ? level - table.down[level] : 1);
+        level = level > kDimmingMaxLevel ? kDimmingMaxLevel : level;
+        ticks++;
+    }
+    return ticks;
+}
+
+/* Tick indexed curves; DIMMING_CURVE_PERCEPTUAL is looked up in kDimmingPerceptual instead */
+inline constexpr app_dimming_curve_table_t kDimmingCurves[DIMMING_CURVE_MAX] = {
+    app_dimming_curve_make_linear(),
+    {},
+    app_dimming_curve_make_accelerating(),
+};
+
+inline constexpr app_dimming_perceptual_table_t kDimmingPerceptual = app_dimming_curve_make_perceptual();
+
+static_assert(app_dimming_curve_sweep_ticks(kDimmingCurves[DIMMING_CURVE_LINEAR]) == 85, "Linear sweep changed");
+static_assert(app_dimming_curve_perceptual_sweep_ticks(kDimmingPerceptual, true) <= kDimmingCurveLength &&
+              app_dimming_curve_perceptual_sweep_ticks(kDimmingPerceptual, false) <= kDimmingCurveLength,
+              "Perceptual curve must sweep the full range within the table length");
+static_assert(app_dimming_curve_sweep_ticks(kDimmingCurves[DIMMING_CURVE_ACCELERATING]) <= kDimmingCurveLength,
+              "Accelerating curve must sweep the full range within the table");
+
+/** Step size for a hold tick
+ *
+ * @param[in] curve Curve to use.
+ * @param[in] up true when dimming up.
+ * @param[in] hold_index Zero based index of the hold tick, used by the linear and accelerating
+ *                       curves. Ticks past the end of the table reuse its last entry.
+ * @param[in] level Level the lights are at, or the best estimate of it, used by the
+ *                  perceptual curve. Steps shrink as the level approaches the low end.
+ *
+ * @return Step size to send.
+ */
+inline uint8_t app_dimming_curve_step_size(app_dimming_curve_t curve, bool up, uint16_t hold_index, uint8_t level)
+{
+    if (curve == DIMMING_CURVE_PERCEPTUAL) {
+        uint8_t index = level > kDimmingMaxLevel ? kDimmingMaxLevel : level;
+        return up ? kDimmingPerceptual.up[index] : kDimmingPerceptual.down[index];
+    }
+    size_t index = hold_index < kDimmingCurveLength ? hold_index : kDimmingCurveLength - 1;
+    return kDimmingCurves[curve].steps[index];
+}
+
+/** Transition time for a hold tick
+ *
+ * Fading across the interval between ticks keeps the light moving smoothly instead of
+ * jumping on every Step.
+ *
+ * @param[in] tick_interval_ms Time since the previous hold tick.
+ *
+ * @return Transition time in tenths of a second.
+ */
+inline uint16_t app_dimming_curve_transition_time(uint32_t tick_interval_ms)
+{
+    uint32_t transition_time = tick_interval_ms / 100;
+    return transition_time > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(transition_time);
+}
@@ -0,0 +1,235 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <atomic>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+#include <platform/CHIPDeviceLayer.h>
+
+#include <app_dispatch.h>
+
+static const char *TAG = "app_dispatch";
+
+static constexpr uint32_t kQueueSize = 16;
+static_assert((kQueueSize & (kQueueSize - 1)) == 0, "Queue size must be a power of two");
+
+static app_intent_t s_queue[kQueueSize];
+// The producer merges into and evicts from queued slots, so every access to the ring and its
+// indices is made under s_queue_lock. The sections only copy a few intents and never block.
+static portMUX_TYPE s_queue_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_tail = 0;
+static uint32_t s_head = 0;
+static std::atomic<bool> s_drain_scheduled{false};
+
+static app_dispatch_handler_t s_handler = nullptr;
+// app_dispatch_hold_reason_t bits. Only touched in the Matter thread.
+static uint8_t s_hold_reasons = 0;
+
+// posted, dropped, coalesced and max_depth are only written by the producer; max_wait_us only
+// by the consumer.
+static app_dispatch_stats_t s_stats;
+
+static bool app_dispatch_pop(app_intent_t *intent)
+{
+    bool popped = false;
+    taskENTER_CRITICAL(&s_queue_lock);
+    if (s_head != s_tail) {
+        *intent = s_queue[s_head & (kQueueSize - 1)];
+        s_head++;
+        popped = true;
+    }
+    taskEXIT_CRITICAL(&s_queue_lock);
+    return popped;
+}
+
+static void app_dispatch_drain(intptr_t arg)
+{
+    // Clear the flag before draining so an intent posted after the last pop schedules a new drain.
+    s_drain_scheduled.store(false, std::memory_order_release);
+
+    app_intent_t intent;
+    while (s_hold_reasons == 0 && app_dispatch_pop(&intent)) {
+        uint32_t wait_us = static_cast<uint32_t>(esp_timer_get_time()) - intent.post_time_us;
+        if (wait_us > s_stats.max_wait_us) {
+            s_stats.max_wait_us = wait_us;
+        }
+
+        s_handler(&intent);
+    }
+}
+
+static void app_dispatch_schedule()
+{
+    if (!s_drain_scheduled.exchange(true, std::memory_order_acq_rel)) {
+        // ScheduleWork only posts to the Matter event queue, so it doesn't need the stack lock.
+        if (chip::DeviceLayer::PlatformMgr().ScheduleWork(app_dispatch_drain) != CHIP_NO_ERROR) {
+            // The intent stays queued and goes out with the next successful drain.
+            s_drain_scheduled.store(false, std::memory_order_release);
+            ESP_LOGW(TAG, "Failed to schedule drain");
+        }
+    }
+}
+
+// Merges the intent into the one queued last, if they are a run of Steps in the same direction or
+// a run of absolute levels. Only the sum of the Steps and the latest level matter. Must be called
+// with s_queue_lock held.
+static bool app_dispatch_merge_tail(const app_intent_t *intent)
+{
+    if (s_head == s_tail) {
+        return false;
+    }
+    app_intent_t *last = &s_queue[(s_tail - 1) & (kQueueSize - 1)];
+    if (last->type != intent->type || last->endpoint_id != intent->endpoint_id) {
+        return false;
+    }
+    if (intent->type == APP_INTENT_STEP && last->up == intent->up) {
+        uint32_t step_size = last->step_size + intent->step_size;
+        last->step_size = step_size > 254 ? 254 : step_size;
+    } else if (intent->type == APP_INTENT_MOVE_TO_LEVEL) {
+        last->level = intent->level;
+    } else {
+        return false;
+    }
+    last->transition_time = intent->transition_time;
+    return true;
+}
+
+// Steps and levels lose nothing that matters when they are dropped, since the next one still moves
+// the light. A Move only starts a hold whose Stop is kept, and a scene is recalled again with the
+// next press. Toggle, On, Off and Stop are what the user pressed or released and are always kept.
+static bool app_dispatch_is_coalescible(app_intent_type_t type)
+{
+    return type == APP_INTENT_STEP || type == APP_INTENT_MOVE_TO_LEVEL;
+}
+
+static bool app_dispatch_is_replaceable(app_intent_type_t type)
+{
+    return app_dispatch_is_coalescible(type) || type == APP_INTENT_MOVE || type == APP_INTENT_RECALL_SCENE;
+}
+
+// An On, Off or Stop followed by another for the same endpoint and cluster is overridden by it.
+// Must be called with s_queue_lock held.
+static bool app_dispatch_is_overridden(uint32_t index)
+{
+    const app_intent_t *intent = &s_queue[index & (kQueueSize - 1)];
+    bool on_off = intent->type == APP_INTENT_ON || intent->type == APP_INTENT_OFF;
+    if (!on_off && intent->type != APP_INTENT_STOP) {
+        return false;
+    }
+    for (uint32_t i = index + 1; i != s_tail; i++) {
+        const app_intent_t *later = &s_queue[i & (kQueueSize - 1)];
+        if (later->endpoint_id != intent->endpoint_id) {
+            continue;
+        }
+        if (on_off ? (later->type == APP_INTENT_ON || later->type == APP_INTENT_OFF) : later->type == APP_INTENT_STOP) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Frees a slot in a full ring for the intent by evicting the oldest queued intent that matters
+// less: a Step or level first, then a Move or scene, and only for a press or release an On, Off or
+// Stop that a later one overrides. Must be called with s_queue_lock held.
+static bool app_dispatch_evict(const app_intent_t *intent)
+{
+    uint32_t victim = s_tail;
+    for (uint32_t i = s_head; i != s_tail && victim == s_tail; i++) {
+        if (app_dispatch_is_coalescible(s_queue[i & (kQueueSize - 1)].type)) {
+            victim = i;
+        }
+    }
+    if (victim == s_tail && !app_dispatch_is_coalescible(intent->type)) {
+        for (uint32_t i = s_head; i != s_tail && victim == s_tail; i++) {
+            if (app_dispatch_is_replaceable(s_queue[i & (kQueueSize - 1)].type)) {
+                victim = i;
+            }
+        }
+    }
+    if (victim == s_tail && !app_dispatch_is_replaceable(intent->type)) {
+        for (uint32_t i = s_head; i != s_tail && victim == s_tail; i++) {
+            if (app_dispatch_is_overridden(i)) {
+                victim = i;
+            }
+        }
+    }
+    if (victim == s_tail) {
+        return false;
+    }
+
+    for (uint32_t i = victim; i + 1 != s_tail; i++) {
+        s_queue[i & (kQueueSize - 1)] = s_queue[(i + 1) & (kQueueSize - 1)];
+    }
+    s_tail--;
+    return true;
+}
+
+esp_err_t app_dispatch_init(app_dispatch_handler_t handler)
+{
+    if (!handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_handler = handler;
+    return ESP_OK;
+}
+
+esp_err_t app_dispatch_post(const app_intent_t *intent)
+{
+    esp_err_t err = ESP_OK;
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+
+    taskENTER_CRITICAL(&s_queue_lock);
+    if (app_dispatch_merge_tail(intent)) {
+        s_stats.coalesced++;
+    } else {
+        if (s_tail - s_head >= kQueueSize) {
+            if (app_dispatch_evict(intent)) {
+                s_stats.dropped++;
+            } else {
+                err = ESP_ERR_NO_MEM;
+            }
+        }
+        if (err == ESP_OK) {
+            app_intent_t *slot = &s_queue[s_tail & (kQueueSize - 1)];
+            *slot = *intent;
+            slot->post_time_us = now;
+            s_tail++;
+        }
+    }
+    uint32_t depth = s_tail - s_head;
+    taskEXIT_CRITICAL(&s_queue_lock);
+
+    if (err != ESP_OK) {
+        s_stats.dropped++;
+        return err;
+    }
+    s_stats.posted++;
+    if (depth > s_stats.max_depth) {
+        s_stats.max_depth = depth;
+    }
+
+    app_dispatch_schedule();
+    return ESP_OK;
+}
+
+void app_dispatch_hold(app_dispatch_hold_reason_t reason, bool hold)
+{
+    bool was_held = s_hold_reasons != 0;
+    s_hold_reasons = hold ? (s_hold_reasons | reason) : (s_hold_reasons & ~reason);
+    if (was_held && s_hold_reasons == 0) {
+        app_dispatch_schedule();
+    }
+}
+
+void app_dispatch_get_stats(app_dispatch_stats_t *stats)
+{
+    *stats = s_stats;
+}
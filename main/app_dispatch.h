@@ -0,0 +1,105 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+
+/* What the user asked the switch to do. Button callbacks post these and the Matter
+ * thread turns them into commands, so the button task never waits on the stack lock. */
+typedef enum : uint8_t {
+    APP_INTENT_TOGGLE = 0,
+    APP_INTENT_ON,
+    APP_INTENT_OFF,
+    APP_INTENT_STEP,
+    APP_INTENT_MOVE,
+    APP_INTENT_STOP,
+    APP_INTENT_MOVE_TO_LEVEL,
+    APP_INTENT_RECALL_SCENE,
+} app_intent_type_t;
+
+typedef struct {
+    app_intent_type_t type;
+    /* Dimming direction for APP_INTENT_STEP and APP_INTENT_MOVE */
+    bool up;
+    /* Step size for APP_INTENT_STEP */
+    uint8_t step_size;
+    /* Rate for APP_INTENT_MOVE, in level units per second */
+    uint8_t rate;
+    /* Target level for APP_INTENT_MOVE_TO_LEVEL */
+    uint8_t level;
+    /* Scene for APP_INTENT_RECALL_SCENE */
+    uint8_t scene_id;
+    /* Transition time for APP_INTENT_STEP and APP_INTENT_MOVE_TO_LEVEL, in tenths of a second */
+    uint16_t transition_time;
+    /* Local switch endpoint the intent came from */
+    uint16_t endpoint_id;
+    /* Latency trace ID from app_trace_begin(), 0 when not traced */
+    uint16_t trace_id;
+    /* Low 32 bits of esp_timer_get_time() when the intent was posted. Set by app_dispatch_post(). */
+    uint32_t post_time_us;
+} app_intent_t;
+
+typedef struct {
+    uint32_t posted;
+    uint32_t dropped;
+    uint32_t coalesced;
+    uint32_t max_depth;
+    uint32_t max_wait_us;
+} app_dispatch_stats_t;
+
+typedef enum : uint8_t {
+    /* Presses taken during startup wait for the fabric to be up */
+    APP_DISPATCH_HOLD_STARTUP = 1 << 0,
+} app_dispatch_hold_reason_t;
+
+/** Handler run in the Matter thread, with the stack lock held, for every drained intent */
+typedef void (*app_dispatch_handler_t)(const app_intent_t *intent);
+
+/** Initialize the dispatcher
+ *
+ * @param[in] handler Handler for drained intents.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_dispatch_init(app_dispatch_handler_t handler);
+
+/** Post an intent to the Matter thread
+ *
+ * Copies the intent into a single-producer/single-consumer ring and schedules a drain on the
+ * Matter thread if one isn't pending. Never blocks. A Step in the same direction as the last
+ * queued one, or a level after a level, is merged into it. When the ring is full, the oldest
+ * queued Step or level is evicted to make room; Toggle, On, Off and Stop are never dropped for
+ * them. All intents must be posted from the same task; the button component runs every
+ * callback on its timer task.
+ *
+ * @param[in] intent Intent to post.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NO_MEM if the ring is full of intents that can't make room and the intent was dropped.
+ */
+esp_err_t app_dispatch_post(const app_intent_t *intent);
+
+/** Hold or resume draining
+ *
+ * While held, posted intents stay in the ring, where runs of Steps and levels coalesce as
+ * they are posted. Each reason holds independently, and draining
+ * resumes once none is left. Must be called in the Matter thread, or before it is started.
+ *
+ * @param[in] reason Why draining is held.
+ * @param[in] hold true to hold, false to resume.
+ */
+void app_dispatch_hold(app_dispatch_hold_reason_t reason, bool hold);
+
+/** Read the dispatcher counters
+ *
+ * @param[out] stats Counters since boot.
+ */
+void app_dispatch_get_stats(app_dispatch_stats_t *stats);
@@ -7,9 +7,14 @@
 */
 
 #include "esp_matter_client.h"
+#include <atomic>
 #include <cstddef>
 #include <cstdio>
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -18,34 +23,342 @@
 
 #include <iot_button.h>
 
+#include <app_boot.h>
+#include <app_command.h>
+#include <app_dimming_curve.h>
+#include <app_dispatch.h>
+#include <app_gesture.h>
+#include <app_inflight.h>
+#include <app_led.h>
+#include <app_input.h>
+#include <app_level_model.h>
+#include <app_log.h>
+#include <app_peer_cache.h>
+#include <app_power.h>
+#include <app_ram.h>
 #include <app_priv.h>
 #include <app_reset.h>
+#include <app_touch.h>
+#include <app_trace.h>
 
 #include <app/server/Server.h>
 #include <lib/core/Optional.h>
 
-using chip::kInvalidClusterId;
-static constexpr chip::CommandId kInvalidCommandId = 0xFFFF'FFFF;
-
 using namespace chip::app::Clusters;
 using namespace esp_matter;
 using namespace esp_matter::cluster;
 
 static const char *TAG = "app_driver";
-extern uint16_t switch_endpoint_id;
 
-static void send_command_success_callback(void *context, const ConcreteCommandPath &command_path,
-                                          const chip::app::StatusIB &status, TLVReader *response_data)
+#if CONFIG_DIMMER_SWITCH_INPUT_TOUCH
+// A single touch pad or slider.
+static constexpr uint8_t kSwitchCount = 1;
+#else
+static constexpr uint8_t kSwitchCount = CONFIG_DIMMER_SWITCH_BUTTON_COUNT;
+
+typedef struct {
+    gpio_num_t gpio;
+    uint8_t active_level;
+} app_button_t;
+
+// One button per gang, each driving its own dimmer_switch endpoint.
+static constexpr app_button_t kButtons[] = {
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON1_GPIO), 1},
+#if CONFIG_DIMMER_SWITCH_BUTTON_COUNT >= 2
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON2_GPIO), 1},
+#endif
+#if CONFIG_DIMMER_SWITCH_BUTTON_COUNT >= 3
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON3_GPIO), 1},
+#endif
+#if CONFIG_DIMMER_SWITCH_BUTTON_COUNT >= 4
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON4_GPIO), 1},
+#endif
+#if CONFIG_DIMMER_SWITCH_BUTTON_COUNT >= 5
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON5_GPIO), 1},
+#endif
+#if CONFIG_DIMMER_SWITCH_BUTTON_COUNT >= 6
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON6_GPIO), 1},
+#endif
+#if CONFIG_DIMMER_SWITCH_BUTTON_COUNT >= 7
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON7_GPIO), 1},
+#endif
+#if CONFIG_DIMMER_SWITCH_BUTTON_COUNT >= 8
+    {static_cast<gpio_num_t>(CONFIG_DIMMER_SWITCH_BUTTON8_GPIO), 1},
+#endif
+};
+static_assert(sizeof(kButtons) / sizeof(kButtons[0]) == kSwitchCount, "Button table doesn't match the button count");
+#endif
+
+// Per gang state. The gesture recognizer and the hold fields are only touched in the button
+// task; hold_message_count only in the Matter thread.
+// Fields are ordered by size, largest first, so the array has no padding between them.
+typedef struct {
+    int64_t hold_start_time;
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    int64_t last_fallback_step_time;
+#endif
+    app_gesture_t gesture;
+#if CONFIG_DIMMER_SWITCH_GPIO_INTERRUPT
+    app_input_t input;
+#endif
+#if !CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    uint32_t last_hold_time;
+#endif
+    // Written in the Matter thread, read in the button task. Each preset is its kind in the
+    // high byte and its level or scene ID in the low byte.
+    std::atomic<uint16_t> presets[APP_PRESETS_MAX];
+    uint16_t endpoint_id;
+    uint16_t hold_message_count;
+    std::atomic<uint8_t> preset_count;
+    // Preset the next recall sends, only touched in the button task.
+    uint8_t preset_index;
+    // Level the current hold has driven the lights to. An estimate unless hold_absolute is set.
+    uint8_t hold_level;
+    uint8_t direction_up : 1;
+    // Set between the start of a hold and its release.
+    uint8_t dimming_active : 1;
+    uint8_t hold_absolute : 1;
+} app_switch_t;
+
+static app_switch_t s_switches[kSwitchCount];
+
+// Endpoints are created back to back, so the switch behind an endpoint is found by offset.
+static app_switch_t *app_driver_switch_from_endpoint(uint16_t endpoint_id)
 {
-    ESP_LOGI(TAG, "Send command success");
+    uint16_t index = endpoint_id - s_switches[0].endpoint_id;
+    if (index >= kSwitchCount || s_switches[index].endpoint_id != endpoint_id)
+    {
+        return nullptr;
+    }
+    return &s_switches[index];
 }
 
-static void send_command_failure_callback(void *context, CHIP_ERROR error)
+// Intents handed to the client, kept until their requests are sent. The client copies the
+// request handle and may hold on to it until the peer's CASE session is up, so request_data
+// carries the ID of the intent rather than a payload the next intent would overwrite. The
+// payload, trace and endpoint are looked up when the request is finally sent. Only touched in
+// the Matter thread.
+static constexpr size_t kSendContextCount = 16;
+// IDs stay below every RAM address, so they can't be mistaken for the argument pointer of a
+// request made from the client console.
+static constexpr uint32_t kSendContextIdLimit = 1U << 24;
+static app_intent_t s_send_contexts[kSendContextCount];
+static uint32_t s_send_context_ids[kSendContextCount];
+static uint32_t s_next_send_context_id = 0;
+
+// Command payloads built for one request when it is sent.
+typedef struct {
+    LevelControl::Commands::Step::Type step;
+    LevelControl::Commands::MoveToLevelWithOnOff::Type move_to_level;
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    LevelControl::Commands::Move::Type move;
+    LevelControl::Commands::Stop::Type stop;
+#endif
+    ScenesManagement::Commands::RecallScene::Type recall_scene;
+} app_request_payload_t;
+
+#if CONFIG_DIMMER_SWITCH_DIMMING_STEP
+#if CONFIG_DIMMER_SWITCH_CURVE_PERCEPTUAL
+static constexpr app_dimming_curve_t kDimmingCurve = DIMMING_CURVE_PERCEPTUAL;
+#elif CONFIG_DIMMER_SWITCH_CURVE_ACCELERATING
+static constexpr app_dimming_curve_t kDimmingCurve = DIMMING_CURVE_ACCELERATING;
+#else
+static constexpr app_dimming_curve_t kDimmingCurve = DIMMING_CURVE_LINEAR;
+#endif
+#endif
+
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+// Lights that answered Move with UNSUPPORTED_COMMAND. They are dimmed with Steps instead.
+static constexpr size_t kMaxMoveUnsupportedNodes = 8;
+static chip::NodeId s_move_unsupported_nodes[kMaxMoveUnsupportedNodes];
+static size_t s_move_unsupported_count = 0;
+
+static bool is_move_unsupported(chip::NodeId node_id)
 {
-    ESP_LOGI(TAG, "Send command failure: err :%" CHIP_ERROR_FORMAT, error.Format());
+    for (size_t i = 0; i < s_move_unsupported_count; i++)
+    {
+        if (s_move_unsupported_nodes[i] == node_id)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
-LevelControl::StepModeEnum current_step_direction = LevelControl::StepModeEnum::kUp;
+static void mark_move_unsupported(chip::NodeId node_id)
+{
+    if (is_move_unsupported(node_id) || s_move_unsupported_count >= kMaxMoveUnsupportedNodes)
+    {
+        return;
+    }
+    s_move_unsupported_nodes[s_move_unsupported_count++] = node_id;
+    APP_LOGW(TAG, "Node 0x%llx does not support Move, falling back to Step", node_id);
+}
+
+// In Move mode, Step commands only drive the lights that rejected Move, and those lights
+// are not sent Move or Stop again.
+static bool app_driver_should_send(chip::NodeId node_id, const client::request_handle_t *req_handle)
+{
+    if (req_handle->command_path.mClusterId != LevelControl::Id)
+    {
+        return true;
+    }
+
+    switch (req_handle->command_path.mCommandId)
+    {
+    case LevelControl::Commands::Move::Id:
+    case LevelControl::Commands::Stop::Id:
+        return !is_move_unsupported(node_id);
+    case LevelControl::Commands::Step::Id:
+        return is_move_unsupported(node_id);
+    default:
+        return true;
+    }
+}
+#endif
+
+#if CONFIG_DIMMER_SWITCH_GROUPCAST_FANOUT
+// Commands that a bound group carries to its members. Members that are bound individually
+// as well don't need a unicast copy.
+static bool app_driver_sent_by_group(const client::request_handle_t *req_handle)
+{
+    switch (req_handle->command_path.mClusterId)
+    {
+    case OnOff::Id:
+        return true;
+    case LevelControl::Id:
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+        // Fallback Steps are unicast only.
+        return req_handle->command_path.mCommandId != LevelControl::Commands::Step::Id;
+#else
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+#endif
+
+// Stores the intent for the requests about to be handed to the client and returns the ID they
+// carry in request_data. The oldest stored intent is reused once they are all taken.
+static void *app_driver_save_send_context(const app_intent_t *intent)
+{
+    // 0 marks a request the driver didn't make, so it is skipped when the counter wraps.
+    uint32_t id = s_next_send_context_id + 1 < kSendContextIdLimit ? s_next_send_context_id + 1 : 1;
+    s_next_send_context_id = id;
+    s_send_contexts[id % kSendContextCount] = *intent;
+    s_send_context_ids[id % kSendContextCount] = id;
+    return reinterpret_cast<void *>(static_cast<uintptr_t>(id));
+}
+
+// Builds the payload of a request from the intent it was made for, and points a copy of the
+// request at it.
+static void app_driver_build_request(const app_intent_t *intent, const client::request_handle_t *req_handle,
+                                     app_request_payload_t *payload, client::request_handle_t *request)
+{
+    auto options = static_cast<chip::BitMask<chip::app::Clusters::LevelControl::LevelControlOptions>>(0U);
+
+    *request = *req_handle;
+    request->request_data = nullptr;
+
+    switch (intent->type)
+    {
+    case APP_INTENT_STEP:
+        payload->step.stepMode = intent->up ? LevelControl::StepModeEnum::kUp : LevelControl::StepModeEnum::kDown;
+        payload->step.stepSize = intent->step_size;
+        payload->step.transitionTime.SetNonNull(intent->transition_time);
+        payload->step.optionsMask = options;
+        payload->step.optionsOverride = options;
+        request->request_data = &payload->step;
+        break;
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    case APP_INTENT_MOVE:
+        payload->move.moveMode = intent->up ? LevelControl::MoveModeEnum::kUp : LevelControl::MoveModeEnum::kDown;
+        payload->move.rate.SetNonNull(intent->rate);
+        payload->move.optionsMask = options;
+        payload->move.optionsOverride = options;
+        request->request_data = &payload->move;
+        break;
+    case APP_INTENT_STOP:
+        payload->stop.optionsMask = options;
+        payload->stop.optionsOverride = options;
+        request->request_data = &payload->stop;
+        break;
+#endif
+    case APP_INTENT_MOVE_TO_LEVEL:
+        payload->move_to_level.level = intent->level;
+        payload->move_to_level.transitionTime.SetNonNull(intent->transition_time);
+        payload->move_to_level.optionsMask = options;
+        payload->move_to_level.optionsOverride = options;
+        request->request_data = &payload->move_to_level;
+        break;
+    case APP_INTENT_RECALL_SCENE:
+        payload->recall_scene.sceneID = intent->scene_id;
+        payload->recall_scene.transitionTime.ClearValue();
+        request->request_data = &payload->recall_scene;
+        break;
+    default:
+        break;
+    }
+}
+
+// Resolves a request handed to the client callbacks. A request made by app_driver_cluster_update()
+// gets its payload built from the intent it was made for. One made from the client console is
+// passed on as it is, without an intent. Returns false if the request waited so long that newer
+// intents have reused its context; those newer intents have reached the lights since.
+static bool app_driver_resolve_request(const client::request_handle_t *req_handle, app_request_payload_t *payload,
+                                       client::request_handle_t *request, const app_intent_t **intent)
+{
+    *request = *req_handle;
+    *intent = nullptr;
+
+    uint32_t id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(req_handle->request_data));
+    if (id == 0 || id >= kSendContextIdLimit)
+    {
+        return true;
+    }
+    if (s_send_context_ids[id % kSendContextCount] != id)
+    {
+        return false;
+    }
+    *intent = &s_send_contexts[id % kSendContextCount];
+    app_driver_build_request(*intent, req_handle, payload, request);
+    return true;
+}
+
+static void app_driver_count_hold_message(uint16_t endpoint_id)
+{
+    app_switch_t *sw = app_driver_switch_from_endpoint(endpoint_id);
+    if (sw && sw->dimming_active)
+    {
+        sw->hold_message_count++;
+    }
+}
+
+void app_command_success_cb(const chip::ScopedNodeId &peer, uint16_t sequence,
+                            const chip::app::ConcreteCommandPath &command_path)
+{
+    APP_LOGI(TAG, "Send command success");
+    app_boot_mark(APP_BOOT_FIRST_COMMAND);
+    app_inflight_complete(peer, command_path.mClusterId, sequence, CHIP_NO_ERROR);
+}
+
+void app_command_failure_cb(const chip::ScopedNodeId &peer, uint16_t sequence, chip::ClusterId cluster_id,
+                            chip::CommandId command_id, CHIP_ERROR error)
+{
+    // error.Format() may point at a shared buffer, so the deferred log gets the raw code.
+    APP_LOGI(TAG, "Send command failure: err :0x%" PRIx32, error.AsInteger());
+
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    if (cluster_id == LevelControl::Id && command_id == LevelControl::Commands::Move::Id &&
+        error == CHIP_IM_GLOBAL_STATUS(UnsupportedCommand))
+    {
+        mark_move_unsupported(peer.GetNodeId());
+    }
+#endif
+
+    app_inflight_complete(peer, cluster_id, sequence, error);
+}
 
 void app_driver_client_invoke_command_callback(client::peer_device_t *peer_device, client::request_handle_t *req_handle,
                                                void *priv_data)
@@ -54,194 +367,780 @@ void app_driver_client_invoke_command_callback(client::peer_device_t *peer_devic
     {
         return;
     }
-    char command_data_str[256];
-    // on_off light switch should support on_off cluster and identify cluster commands sending.
-    if (req_handle->command_path.mClusterId == OnOff::Id)
+    app_request_payload_t payload;
+    client::request_handle_t request;
+    const app_intent_t *intent;
+    if (!app_driver_resolve_request(req_handle, &payload, &request, &intent))
+    {
+        APP_LOGW(TAG, "Dropped command 0x%lx deferred past newer intents", req_handle->command_path.mCommandId);
+        return;
+    }
+    uint16_t trace_id = intent ? intent->trace_id : 0;
+    chip::EndpointId local_endpoint = intent ? intent->endpoint_id : chip::kInvalidEndpointId;
+
+    // Counted before anything can skip the send, so a peer without a session counts as a miss.
+    chip::Optional<chip::SessionHandle> session = peer_device->GetSecureSession();
+    chip::ScopedNodeId peer(peer_device->GetDeviceId(),
+                            session.HasValue() ? session.Value()->GetFabricIndex() : chip::kUndefinedFabricIndex);
+    app_peer_cache_record_send(peer);
+
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    if (!app_driver_should_send(peer_device->GetDeviceId(), req_handle))
+    {
+        return;
+    }
+#endif
+
+    // Scenes are only recalled on the bound groups, where one groupcast reaches every light.
+    if (req_handle->command_path.mClusterId == ScenesManagement::Id)
+    {
+        return;
+    }
+
+    if (!session.HasValue())
+    {
+        return;
+    }
+
+#if CONFIG_DIMMER_SWITCH_GROUPCAST_FANOUT
+    if (app_driver_sent_by_group(req_handle) &&
+        app_peer_cache_covered_by_group(peer, local_endpoint, req_handle->command_path.mClusterId))
+    {
+        return;
+    }
+#endif
+
+    esp_err_t err = app_inflight_send(peer_device, &request, trace_id);
+    if (err != ESP_OK)
+    {
+        APP_LOGE(TAG, "Failed to send command 0x%lx to cluster 0x%lx: %s", req_handle->command_path.mCommandId,
+                 req_handle->command_path.mClusterId, esp_err_to_name(err));
+        return;
+    }
+
+    app_driver_count_hold_message(local_endpoint);
+}
+
+void app_driver_client_group_invoke_command_callback(uint8_t fabric_index, client::request_handle_t *req_handle, void *priv_data)
+{
+    if (req_handle->type != esp_matter::client::INVOKE_CMD)
+    {
+        return;
+    }
+    app_request_payload_t payload;
+    client::request_handle_t request;
+    const app_intent_t *intent;
+    if (!app_driver_resolve_request(req_handle, &payload, &request, &intent))
+    {
+        return;
+    }
+
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    // Group invokes are never acknowledged, so a group can't be detected as rejecting Move
+    // and only gets Move and Stop.
+    if (req_handle->command_path.mClusterId == LevelControl::Id &&
+        req_handle->command_path.mCommandId == LevelControl::Commands::Step::Id)
     {
-        strcpy(command_data_str, "{}");
+        return;
     }
-    else if (req_handle->command_path.mClusterId == LevelControl::Id)
+#endif
+
+    chip::GroupId group_id = req_handle->command_path.mGroupId;
+    payload.recall_scene.groupID = group_id;
+    esp_err_t err = app_command_dispatch(&request, [&](const auto &command) {
+        return app_command_send_group(fabric_index, group_id, command);
+    });
+    if (err != ESP_OK)
+    {
+        APP_LOGE(TAG, "Failed to send command 0x%lx to group 0x%x: %s", req_handle->command_path.mCommandId,
+                 group_id, esp_err_to_name(err));
+        return;
+    }
+
+    // Groupcasts are never acked, so only the send is traced.
+    if (intent)
     {
-        LevelControl::Commands::Step::Type *stepCommand = (LevelControl::Commands::Step::Type *)req_handle->request_data;
-        sprintf(command_data_str, "{\"0:U8\": %d, \"1:U8\": %d, \"2:U16\": 0, \"3:U8\": 0, \"4:U8\": 0}", (uint8_t)stepCommand->stepMode, stepCommand->stepSize);
+        app_trace_record(intent->trace_id, APP_TRACE_SEND);
+        app_driver_count_hold_message(intent->endpoint_id);
     }
-    else if (req_handle->command_path.mClusterId == Identify::Id)
+}
+
+// Hands a request to the Matter client for every binding on the switch endpoint. Runs in the
+// Matter thread, which already holds the stack lock.
+static void app_driver_cluster_update(client::request_handle_t *req_handle, const app_intent_t *intent)
+{
+    app_trace_record(intent->trace_id, APP_TRACE_CLUSTER_UPDATE);
+    req_handle->request_data = app_driver_save_send_context(intent);
+
+#if CONFIG_DIMMER_SWITCH_DISPATCH_PROFILING
+    uint32_t start_heap = esp_get_free_heap_size();
+#endif
+
+    client::cluster_update(intent->endpoint_id, req_handle);
+
+#if CONFIG_DIMMER_SWITCH_DISPATCH_PROFILING
+    APP_LOGI(TAG, "Dispatch took %lu us from press, heap used: %ld bytes, stack high water: %u bytes",
+             static_cast<uint32_t>(esp_timer_get_time()) - intent->post_time_us,
+             (long)start_heap - (long)esp_get_free_heap_size(), uxTaskGetStackHighWaterMark(NULL));
+#endif
+}
+
+// Turns a drained intent into commands for the bound lights. The payloads are built from the
+// intent when each request is sent.
+static void app_driver_send_intent(const app_intent_t *intent)
+{
+    client::request_handle_t req_handle;
+    req_handle.type = esp_matter::client::INVOKE_CMD;
+
+    switch (intent->type)
+    {
+    case APP_INTENT_TOGGLE:
+    case APP_INTENT_ON:
+    case APP_INTENT_OFF:
+        req_handle.command_path.mClusterId = OnOff::Id;
+        req_handle.command_path.mCommandId = intent->type == APP_INTENT_ON    ? OnOff::Commands::On::Id
+                                             : intent->type == APP_INTENT_OFF ? OnOff::Commands::Off::Id
+                                                                              : OnOff::Commands::Toggle::Id;
+        break;
+    case APP_INTENT_STEP:
+        req_handle.command_path.mClusterId = LevelControl::Id;
+        req_handle.command_path.mCommandId = LevelControl::Commands::Step::Id;
+        break;
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    case APP_INTENT_MOVE:
+        req_handle.command_path.mClusterId = LevelControl::Id;
+        req_handle.command_path.mCommandId = LevelControl::Commands::Move::Id;
+        break;
+    case APP_INTENT_STOP:
+        req_handle.command_path.mClusterId = LevelControl::Id;
+        req_handle.command_path.mCommandId = LevelControl::Commands::Stop::Id;
+        break;
+#endif
+    case APP_INTENT_MOVE_TO_LEVEL:
+        req_handle.command_path.mClusterId = LevelControl::Id;
+        req_handle.command_path.mCommandId = LevelControl::Commands::MoveToLevelWithOnOff::Id;
+        break;
+    case APP_INTENT_RECALL_SCENE:
+        req_handle.command_path.mClusterId = ScenesManagement::Id;
+        req_handle.command_path.mCommandId = ScenesManagement::Commands::RecallScene::Id;
+        break;
+    default:
+        return;
+    }
+
+    app_driver_cluster_update(&req_handle, intent);
+}
+
+static void app_driver_execute_intent(const app_intent_t *intent)
+{
+    // Poll fast while the commands and their acks are in flight.
+    app_power_notify_activity();
+
+    app_ram_scope_enter(APP_RAM_SCOPE_SEND);
+    app_driver_send_intent(intent);
+    app_ram_scope_exit(APP_RAM_SCOPE_SEND);
+}
+
+// Posts an intent from the button task, tracing it from here to the acks.
+static void app_driver_post(app_intent_t *intent)
+{
+    app_boot_mark(APP_BOOT_FIRST_PRESS);
+    intent->trace_id = app_trace_begin();
+    if (app_dispatch_post(intent) != ESP_OK)
+    {
+        APP_LOGW(TAG, "Dispatch queue full, dropped intent %d", (int)intent->type);
+        return;
+    }
+    app_trace_record(intent->trace_id, APP_TRACE_ENQUEUE);
+}
+
+static esp_err_t app_driver_init()
+{
+    esp_err_t err = app_dispatch_init(app_driver_execute_intent);
+    if (err != ESP_OK)
+    {
+        APP_LOGE(TAG, "Failed to initialize dispatch: %d", err);
+        return err;
+    }
+    client::set_request_callback(app_driver_client_invoke_command_callback,
+                                 app_driver_client_group_invoke_command_callback, NULL);
+    return ESP_OK;
+}
+
+uint8_t app_driver_switch_count()
+{
+    return kSwitchCount;
+}
+
+bool app_driver_gpio_in_use(int gpio_num)
+{
+#if !CONFIG_DIMMER_SWITCH_INPUT_TOUCH
+    for (const app_button_t &button : kButtons)
     {
-        if (req_handle->command_path.mCommandId == Identify::Commands::Identify::Id)
+        if (button.gpio == gpio_num)
         {
-            if (((char *)req_handle->request_data)[0] != 1)
-            {
-                ESP_LOGE(TAG, "Number of parameters error");
-                return;
-            }
-            sprintf(command_data_str, "{\"0:U16\": %ld}", strtoul((const char *)(req_handle->request_data) + 1, NULL, 16));
+            return true;
         }
-        else
+    }
+#endif
+    return false;
+}
+
+esp_err_t app_driver_switch_set_endpoint(uint8_t index, uint16_t endpoint_id)
+{
+    if (index >= kSwitchCount)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_switches[index].endpoint_id = endpoint_id;
+    return ESP_OK;
+}
+
+esp_err_t app_driver_switch_set_presets(uint16_t endpoint_id, const uint8_t *data, uint16_t size)
+{
+    app_switch_t *sw = app_driver_switch_from_endpoint(endpoint_id);
+    if (!sw || (size > 0 && !data) || size % 2 != 0 || size / 2 > APP_PRESETS_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint16_t i = 0; i < size; i += 2)
+    {
+        if ((data[i] != APP_PRESET_LEVEL && data[i] != APP_PRESET_SCENE) || data[i + 1] == 0xFF)
         {
-            ESP_LOGE(TAG, "Unsupported command");
-            return;
+            return ESP_ERR_INVALID_ARG;
         }
     }
-    else
+
+    uint8_t count = size / 2;
+    for (uint8_t i = 0; i < count; i++)
     {
-        ESP_LOGE(TAG, "Unsupported cluster: %ld", req_handle->command_path.mClusterId);
+        sw->presets[i].store(static_cast<uint16_t>(data[2 * i] << 8 | data[2 * i + 1]), std::memory_order_relaxed);
+    }
+    sw->preset_count.store(count, std::memory_order_release);
+    return ESP_OK;
+}
+
+#if CONFIG_DIMMER_SWITCH_LOAD_COMMAND
+// Synthetic hold traffic for load testing against many bound lights. Intents are posted from
+// an esp_timer callback, which runs in the same task as the button callbacks, so the dispatch
+// ring keeps a single producer.
+static constexpr uint8_t kLoadStepSize = 8;
+// Steps per sweep before the direction flips, so the lights don't park at one end of the range.
+static constexpr uint32_t kLoadSweepLength = 16;
+
+static esp_timer_handle_t s_load_timer = nullptr;
+static uint8_t s_load_switch = 0;
+static uint32_t s_load_remaining = 0;
+static uint32_t s_load_posted = 0;
+static int64_t s_load_start_time = 0;
+static app_dispatch_stats_t s_load_dispatch_start;
+static app_inflight_stats_t s_load_inflight_start;
+
+static void app_driver_load_cb(void *arg)
+{
+    if (s_load_remaining == 0)
+    {
+        esp_timer_stop(s_load_timer);
         return;
     }
 
-    client::interaction::invoke::send_request(NULL,
-                                              peer_device,
-                                              req_handle->command_path,
-                                              command_data_str,
-                                              send_command_success_callback,
-                                              send_command_failure_callback,
-                                              chip::NullOptional);
+    app_intent_t intent = {};
+    intent.type = APP_INTENT_STEP;
+    intent.up = (s_load_posted / kLoadSweepLength) % 2 == 0;
+    intent.step_size = kLoadStepSize;
+    intent.endpoint_id = s_switches[s_load_switch].endpoint_id;
+    app_driver_post(&intent);
+
+    s_load_posted++;
+    s_load_remaining--;
 }
 
-void app_driver_client_group_invoke_command_callback(uint8_t fabric_index, client::request_handle_t *req_handle, void *priv_data)
+static esp_err_t app_driver_load_start(uint8_t index, uint32_t count, uint32_t interval_ms)
 {
-    if (req_handle->type != esp_matter::client::INVOKE_CMD)
+    if (index >= kSwitchCount || count == 0 || interval_ms == 0)
     {
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
-    char command_data_str[32];
-    // on_off light switch should support on_off cluster and identify cluster commands sending.
-    if (req_handle->command_path.mClusterId == OnOff::Id)
+    if (!s_load_timer)
     {
-        strcpy(command_data_str, "{}");
+        esp_timer_create_args_t timer_args = {};
+        timer_args.callback = app_driver_load_cb;
+        timer_args.name = "load";
+        esp_err_t err = esp_timer_create(&timer_args, &s_load_timer);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
     }
-    else if (req_handle->command_path.mClusterId == LevelControl::Id)
+    if (esp_timer_is_active(s_load_timer))
     {
-        strcpy(command_data_str, "{}");
+        return ESP_ERR_INVALID_STATE;
     }
-    else if (req_handle->command_path.mClusterId == Identify::Id)
+
+    s_load_switch = index;
+    s_load_remaining = count;
+    s_load_posted = 0;
+    s_load_start_time = esp_timer_get_time();
+    app_dispatch_get_stats(&s_load_dispatch_start);
+    app_inflight_get_stats(&s_load_inflight_start);
+    return esp_timer_start_periodic(s_load_timer, interval_ms * 1000);
+}
+
+// Counters are read without synchronization, so a line may be off by an intent posted while
+// it was printed.
+static void app_driver_load_print()
+{
+    app_dispatch_stats_t dispatch;
+    app_inflight_stats_t inflight;
+    app_dispatch_get_stats(&dispatch);
+    app_inflight_get_stats(&inflight);
+
+    uint32_t elapsed_ms = static_cast<uint32_t>((esp_timer_get_time() - s_load_start_time) / 1000);
+    uint32_t sent = inflight.sent - s_load_inflight_start.sent;
+    printf("posted=%lu remaining=%lu elapsed=%lu ms sent=%lu (%lu/s)\n", s_load_posted, s_load_remaining,
+           elapsed_ms, sent, elapsed_ms ? sent * 1000 / elapsed_ms : 0);
+    printf("dispatch dropped=%lu coalesced=%lu max_depth=%lu max_wait=%lu us\n",
+           dispatch.dropped - s_load_dispatch_start.dropped, dispatch.coalesced - s_load_dispatch_start.coalesced,
+           dispatch.max_depth, dispatch.max_wait_us);
+    printf("inflight superseded=%lu timeouts=%lu retries=%lu dropped=%lu backpressure=%lu\n",
+           inflight.superseded - s_load_inflight_start.superseded, inflight.timeouts - s_load_inflight_start.timeouts,
+           inflight.retries - s_load_inflight_start.retries, inflight.dropped - s_load_inflight_start.dropped,
+           inflight.backpressure - s_load_inflight_start.backpressure);
+    printf("heap free=%lu min_free=%lu\n", esp_get_free_heap_size(), esp_get_minimum_free_heap_size());
+
+    app_power_stats_t power;
+    app_power_get_stats(&power);
+    printf("power wakes=%lu active=%lu ms\n", power.wakes, power.active_ms);
+}
+
+static esp_err_t app_driver_load_console_handler(int argc, char **argv)
+{
+    if (argc == 0 || strcmp(argv[0], "stats") == 0)
     {
-        if (req_handle->command_path.mCommandId == Identify::Commands::Identify::Id)
+        app_driver_load_print();
+    }
+    else if (strcmp(argv[0], "start") == 0 && argc == 4)
+    {
+        esp_err_t err = app_driver_load_start(static_cast<uint8_t>(strtoul(argv[1], NULL, 10)),
+                                              strtoul(argv[2], NULL, 10), strtoul(argv[3], NULL, 10));
+        if (err != ESP_OK)
         {
-            if (((char *)req_handle->request_data)[0] != 1)
-            {
-                ESP_LOGE(TAG, "Number of parameters error");
-                return;
-            }
-            sprintf(command_data_str, "{\"0:U16\": %ld}",
-                    strtoul((const char *)(req_handle->request_data) + 1, NULL, 16));
+            APP_LOGE(TAG, "Failed to start load, err:%d", err);
+            return err;
         }
-        else
+    }
+    else if (strcmp(argv[0], "stop") == 0)
+    {
+        if (s_load_timer)
         {
-            ESP_LOGE(TAG, "Unsupported command");
-            return;
+            esp_timer_stop(s_load_timer);
         }
+        app_driver_load_print();
     }
     else
     {
-        ESP_LOGE(TAG, "Unsupported cluster: %ld", req_handle->command_path.mClusterId);
-        return;
+        APP_LOGE(TAG, "Usage: load [stats|start <switch> <count> <interval_ms>|stop]");
+        return ESP_ERR_INVALID_ARG;
     }
+    return ESP_OK;
+}
+
+esp_err_t app_driver_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "load",
+        .description = "Synthetic hold traffic. Usage: matter esp load [stats|start <switch> <count> <interval_ms>|stop]",
+        .handler = app_driver_load_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
+#else
+esp_err_t app_driver_register_commands()
+{
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_DIMMER_SWITCH_TOUCH_SLIDER
+static void app_driver_slider_cb(uint8_t level)
+{
+    app_ram_scope_enter(APP_RAM_SCOPE_PRESS);
+    app_power_wake();
 
-    client::interaction::invoke::send_group_request(fabric_index, req_handle->command_path, command_data_str);
+    app_intent_t intent = {};
+    intent.type = APP_INTENT_MOVE_TO_LEVEL;
+    intent.level = level;
+    // Fade over roughly the slider report interval.
+    intent.transition_time = 1;
+    intent.endpoint_id = s_switches[0].endpoint_id;
+
+    app_driver_post(&intent);
+    app_led_show_level(level);
+    app_ram_scope_exit(APP_RAM_SCOPE_PRESS);
 }
 
-static void swap_dimmer_direction() 
+app_driver_handle_t app_driver_switch_init(uint8_t index)
+{
+    if (index >= kSwitchCount)
+    {
+        return NULL;
+    }
+    ESP_ERROR_CHECK(app_driver_init());
+
+    // The slider reports levels directly, there is no button behind it.
+    ESP_ERROR_CHECK(app_touch_slider_init(app_driver_slider_cb));
+    return NULL;
+}
+#else
+static void swap_dimmer_direction(app_switch_t *sw)
 {
     // Swap the direction of the Step Command
-    //
-    if(current_step_direction == LevelControl::StepModeEnum::kUp) 
+    sw->direction_up = !sw->direction_up;
+
+    APP_LOGI(TAG, "Endpoint %u dimmer direction is now: %s", sw->endpoint_id, sw->direction_up ? "up" : "down");
+}
+
+static void app_driver_post_intent(app_switch_t *sw, app_intent_type_t type, uint8_t step_size = 0,
+                                   uint16_t transition_time = 0)
+{
+    app_intent_t intent = {};
+    intent.type = type;
+    intent.up = sw->direction_up;
+    intent.step_size = step_size;
+    intent.transition_time = transition_time;
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    intent.rate = CONFIG_DIMMER_SWITCH_MOVE_RATE;
+#endif
+    intent.endpoint_id = sw->endpoint_id;
+
+    app_driver_post(&intent);
+}
+
+static void app_driver_post_level(app_switch_t *sw, uint8_t level, uint16_t transition_time)
+{
+    app_intent_t intent = {};
+    intent.type = APP_INTENT_MOVE_TO_LEVEL;
+    intent.level = level;
+    intent.transition_time = transition_time;
+    intent.endpoint_id = sw->endpoint_id;
+
+    app_driver_post(&intent);
+}
+
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+// Drives the lights that rejected Move. Hold ticks closer together than the fallback interval
+// are coalesced, and the Step covers the distance a Move would have travelled since the last one.
+static void app_driver_post_fallback_step(app_switch_t *sw)
+{
+    if (s_move_unsupported_count == 0)
     {
-        current_step_direction = LevelControl::StepModeEnum::kDown;
+        return;
     }
-    else 
+
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_ms = (now - sw->last_fallback_step_time) / 1000;
+    if (elapsed_ms < CONFIG_DIMMER_SWITCH_FALLBACK_STEP_INTERVAL_MS)
     {
-        current_step_direction = LevelControl::StepModeEnum::kUp;
+        return;
     }
+    sw->last_fallback_step_time = now;
 
-    ESP_LOGI(TAG, "Dimmer Direction is now: %d", (int)current_step_direction);
+    int64_t step_size = elapsed_ms * CONFIG_DIMMER_SWITCH_MOVE_RATE / 1000;
+    step_size = step_size < 1 ? 1 : (step_size > 254 ? 254 : step_size);
+
+    // Transition time is in tenths of a second; fade across the interval so the light moves smoothly.
+    app_driver_post_intent(sw, APP_INTENT_STEP, static_cast<uint8_t>(step_size),
+                           static_cast<uint16_t>(elapsed_ms / 100));
 }
+#endif
 
-static void app_driver_button_press_up_cb(void *arg, void *data)
+static void app_driver_end_dimming(app_switch_t *sw)
 {
-    ESP_LOGI(TAG, "Button Press Up");
+    if (!sw->dimming_active)
+    {
+        return;
+    }
 
-    if (iot_button_get_ticks_time((button_handle_t)arg) < 1000)
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    app_driver_post_intent(sw, APP_INTENT_STOP);
+#endif
+
+    sw->dimming_active = false;
+    APP_LOGI(TAG, "Hold sent %u messages in %lld ms", sw->hold_message_count,
+             (esp_timer_get_time() - sw->hold_start_time) / 1000);
+}
+
+#if CONFIG_DIMMER_SWITCH_TAP_ACTION_ON
+static constexpr app_intent_type_t kTapAction = APP_INTENT_ON;
+#elif CONFIG_DIMMER_SWITCH_TAP_ACTION_OFF
+static constexpr app_intent_type_t kTapAction = APP_INTENT_OFF;
+#else
+static constexpr app_intent_type_t kTapAction = APP_INTENT_TOGGLE;
+#endif
+
+#if CONFIG_DIMMER_SWITCH_DOUBLE_TAP
+#if CONFIG_DIMMER_SWITCH_DOUBLE_TAP_ACTION_TOGGLE
+static constexpr app_intent_type_t kDoubleTapAction = APP_INTENT_TOGGLE;
+#elif CONFIG_DIMMER_SWITCH_DOUBLE_TAP_ACTION_ON
+static constexpr app_intent_type_t kDoubleTapAction = APP_INTENT_ON;
+#elif CONFIG_DIMMER_SWITCH_DOUBLE_TAP_ACTION_OFF
+static constexpr app_intent_type_t kDoubleTapAction = APP_INTENT_OFF;
+#elif CONFIG_DIMMER_SWITCH_DOUBLE_TAP_ACTION_PRESET
+// Presets fade in over half a second.
+static constexpr uint16_t kPresetTransitionTime = 5;
+#else
+// Full brightness
+static constexpr app_intent_type_t kDoubleTapAction = APP_INTENT_MOVE_TO_LEVEL;
+#endif
+#endif
+
+#if CONFIG_DIMMER_SWITCH_DOUBLE_TAP_ACTION_PRESET
+// A preset is one message in total: a MoveToLevelWithOnOff to each light, or a single scene
+// recall groupcast, instead of a hold's worth of Steps.
+static void app_driver_recall_next_preset(app_switch_t *sw)
+{
+    uint8_t count = sw->preset_count.load(std::memory_order_acquire);
+    if (count == 0)
     {
-        ESP_LOGI(TAG, "Single Click");
-        client::request_handle_t req_handle;
-        req_handle.type = esp_matter::client::INVOKE_CMD;
-        req_handle.command_path.mClusterId = OnOff::Id;
-        req_handle.command_path.mCommandId = OnOff::Commands::Toggle::Id;
+        APP_LOGW(TAG, "Endpoint %u has no presets", sw->endpoint_id);
+        return;
+    }
+    if (sw->preset_index >= count)
+    {
+        sw->preset_index = 0;
+    }
+    uint16_t preset = sw->presets[sw->preset_index].load(std::memory_order_relaxed);
+    sw->preset_index++;
 
-        lock::chip_stack_lock(portMAX_DELAY);
-        client::cluster_update(switch_endpoint_id, &req_handle);
-        lock::chip_stack_unlock();
+    uint8_t value = preset & 0xFF;
+    if (preset >> 8 == APP_PRESET_SCENE)
+    {
+        APP_LOGI(TAG, "Endpoint %u recalling scene %u", sw->endpoint_id, value);
+        app_intent_t intent = {};
+        intent.type = APP_INTENT_RECALL_SCENE;
+        intent.scene_id = value;
+        intent.endpoint_id = sw->endpoint_id;
+        app_driver_post(&intent);
     }
     else
     {
-        ESP_LOGI(TAG, "Long Press");
-        swap_dimmer_direction();
+        APP_LOGI(TAG, "Endpoint %u going to preset level %u", sw->endpoint_id, value);
+        app_driver_post_level(sw, value, kPresetTransitionTime);
+        app_led_show_level(value);
     }
 }
+#endif
 
-static void app_driver_button_dimming_cb(void *arg, void *data)
+static void app_driver_hold_start(app_switch_t *sw)
 {
-    ESP_LOGI(TAG, "Long Press Hold");
+    sw->dimming_active = true;
+    sw->hold_message_count = 0;
+    sw->hold_start_time = esp_timer_get_time();
 
-    uint16_t hold_count = iot_button_get_long_press_hold_cnt((button_handle_t)arg);
-    uint32_t hold_time = iot_button_get_ticks_time((button_handle_t)arg);
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+    // Dim down from the top half, up from the bottom half or from off. The model reports the
+    // lead light, so lights at other levels join it on the first tick.
+    app_level_model_state_t state;
+    bool known = app_level_model_get(sw->endpoint_id, &state);
+    if (known)
+    {
+        sw->direction_up = !state.on || state.level < kDimmingMaxLevel / 2;
+        APP_LOGI(TAG, "Lights at %u (%s), dimming %s", state.level, state.on ? "on" : "off",
+                 sw->direction_up ? "up" : "down");
+    }
+#endif
 
-    ESP_LOGI(TAG, "Long Press Hold Count: %d", hold_count);
-    ESP_LOGI(TAG, "Long Press Hold Time: %ld", hold_time);
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    sw->last_fallback_step_time = sw->hold_start_time;
+    app_driver_post_intent(sw, APP_INTENT_MOVE);
+#else
+    sw->last_hold_time = 0;
+    // Without a reading, a hold up is taken to start from the bottom and a hold down from the top.
+    sw->hold_level = sw->direction_up ? 0 : kDimmingMaxLevel;
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+    sw->hold_absolute = known;
+    if (known)
+    {
+        sw->hold_level = state.on ? state.level : 0;
+    }
+#endif
+#endif
+}
 
-    LevelControl::Commands::Step::Type stepCommand;
-    stepCommand.stepMode = current_step_direction;
-    stepCommand.stepSize = 3;
-    stepCommand.transitionTime.SetNonNull(0);
-    stepCommand.optionsMask = static_cast<chip::BitMask<chip::app::Clusters::LevelControl::LevelControlOptions>>(0U);
-    stepCommand.optionsOverride = static_cast<chip::BitMask<chip::app::Clusters::LevelControl::LevelControlOptions>>(0U);
+static void app_driver_hold_tick(app_switch_t *sw, const app_gesture_event_t *event)
+{
+#if CONFIG_DIMMER_SWITCH_DIMMING_MOVE
+    app_driver_post_fallback_step(sw);
+#else
+    uint16_t hold_index = event->hold_count > 0 ? event->hold_count - 1 : 0;
+    uint32_t tick_interval = hold_index > 0 ? event->hold_time_ms - sw->last_hold_time : 0;
+    sw->last_hold_time = event->hold_time_ms;
 
-    client::request_handle_t req_handle;
-    req_handle.type = esp_matter::client::INVOKE_CMD;
-    req_handle.command_path.mClusterId = LevelControl::Id;
-    req_handle.command_path.mCommandId = LevelControl::Commands::Step::Id;
-    req_handle.request_data = &stepCommand;
+    bool up = sw->direction_up;
+    uint8_t step_size = app_dimming_curve_step_size(kDimmingCurve, up, hold_index, sw->hold_level);
+    uint16_t transition_time = app_dimming_curve_transition_time(tick_interval);
 
-    lock::chip_stack_lock(portMAX_DELAY);
-    client::cluster_update(switch_endpoint_id, &req_handle);
-    lock::chip_stack_unlock();
+    int level = up ? sw->hold_level + step_size : sw->hold_level - step_size;
+    level = level < 1 ? 1 : (level > (int)kDimmingMaxLevel ? (int)kDimmingMaxLevel : level);
+    sw->hold_level = static_cast<uint8_t>(level);
+
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+    if (sw->hold_absolute)
+    {
+        // Every tick carries the full target, so a lost or late one is made up by the next.
+        app_driver_post_level(sw, sw->hold_level, transition_time);
+        app_led_show_level(sw->hold_level);
+        return;
+    }
+#endif
+
+    app_driver_post_intent(sw, APP_INTENT_STEP, step_size, transition_time);
+#endif
 }
 
-static void app_driver_button_long_press_up_cb(void *arg, void *data)
+static void app_driver_gesture_cb(const app_gesture_event_t *event, void *priv)
 {
-    ESP_LOGI(TAG, "Long Press Up");
-    swap_dimmer_direction();
+    app_switch_t *sw = static_cast<app_switch_t *>(priv);
+
+    // Hold ticks come from the gesture timer rather than an edge, so the scope is entered here too.
+    app_ram_scope_enter(APP_RAM_SCOPE_PRESS);
+    switch (event->type)
+    {
+    case APP_GESTURE_TAP:
+        APP_LOGI(TAG, "Endpoint %u Tap", sw->endpoint_id);
+        app_driver_post_intent(sw, kTapAction);
+        break;
+#if CONFIG_DIMMER_SWITCH_DOUBLE_TAP
+    case APP_GESTURE_DOUBLE_TAP:
+        APP_LOGI(TAG, "Endpoint %u Double Tap", sw->endpoint_id);
+#if CONFIG_DIMMER_SWITCH_DOUBLE_TAP_ACTION_PRESET
+        app_driver_recall_next_preset(sw);
+#else
+        if (kDoubleTapAction == APP_INTENT_MOVE_TO_LEVEL)
+        {
+            app_driver_post_level(sw, kDimmingMaxLevel, 0);
+        }
+        else
+        {
+            app_driver_post_intent(sw, kDoubleTapAction);
+        }
+#endif
+        break;
+#endif
+    case APP_GESTURE_HOLD_START:
+        APP_LOGI(TAG, "Endpoint %u Hold Started", sw->endpoint_id);
+        app_driver_hold_start(sw);
+        break;
+    case APP_GESTURE_HOLD_TICK:
+        APP_LOGD(TAG, "Hold Tick %u at %lu ms", event->hold_count, event->hold_time_ms);
+        app_driver_hold_tick(sw, event);
+        break;
+    case APP_GESTURE_HOLD_RELEASE:
+        APP_LOGI(TAG, "Endpoint %u Hold Released", sw->endpoint_id);
+        app_driver_end_dimming(sw);
+        // With a level model the next hold picks its own direction; this is the fallback.
+        swap_dimmer_direction(sw);
+        break;
+    default:
+        break;
+    }
+    app_ram_scope_exit(APP_RAM_SCOPE_PRESS);
+}
+
+#if CONFIG_DIMMER_SWITCH_GPIO_INTERRUPT
+static void app_driver_input_cb(bool pressed, void *priv)
+{
+    app_switch_t *sw = static_cast<app_switch_t *>(priv);
+
+    app_ram_scope_enter(APP_RAM_SCOPE_PRESS);
+    if (pressed)
+    {
+        app_power_wake();
+        app_gesture_press(&sw->gesture);
+    }
+    else
+    {
+        app_gesture_release(&sw->gesture);
+    }
+    app_ram_scope_exit(APP_RAM_SCOPE_PRESS);
+}
+
+app_driver_handle_t app_driver_switch_init(uint8_t index)
+{
+    if (index >= kSwitchCount)
+    {
+        return NULL;
+    }
+    if (index == 0)
+    {
+        ESP_ERROR_CHECK(app_driver_init());
+    }
+
+    app_switch_t *sw = &s_switches[index];
+    sw->direction_up = true;
+
+    // Edges come from the pin interrupt; taps and holds are recognized by the gesture.
+    ESP_ERROR_CHECK(app_gesture_init(&sw->gesture, app_driver_gesture_cb, sw));
+    ESP_ERROR_CHECK(app_input_init(&sw->input, kButtons[index].gpio, kButtons[index].active_level,
+                                   app_driver_input_cb, sw));
+
+    // There is no button component handle behind an interrupt driven input.
+    return NULL;
+}
+#else
+static void app_driver_button_press_down_cb(void *arg, void *data)
+{
+    app_ram_scope_enter(APP_RAM_SCOPE_PRESS);
+    app_power_wake();
+    app_gesture_press(&static_cast<app_switch_t *>(data)->gesture);
+    app_ram_scope_exit(APP_RAM_SCOPE_PRESS);
 }
 
-static void app_driver_button_long_press_start_cb(void *arg, void *data)
+static void app_driver_button_press_up_cb(void *arg, void *data)
 {
-    ESP_LOGI(TAG, "Long Press Started");
+    app_ram_scope_enter(APP_RAM_SCOPE_PRESS);
+    app_gesture_release(&static_cast<app_switch_t *>(data)->gesture);
+    app_ram_scope_exit(APP_RAM_SCOPE_PRESS);
 }
 
-app_driver_handle_t app_driver_switch_init()
+app_driver_handle_t app_driver_switch_init(uint8_t index)
 {
+    if (index >= kSwitchCount)
+    {
+        return NULL;
+    }
+    if (index == 0)
+    {
+        ESP_ERROR_CHECK(app_driver_init());
+    }
+
+    app_switch_t *sw = &s_switches[index];
+    sw->direction_up = true;
+
     button_config_t config;
+#if CONFIG_DIMMER_SWITCH_INPUT_TOUCH
+    app_touch_button_config(&config);
+#else
     memset(&config, 0, sizeof(button_config_t));
 
     config.type = BUTTON_TYPE_GPIO;
-    config.gpio_button_config.gpio_num = GPIO_NUM_2;
-    config.gpio_button_config.active_level = 1;
+    config.gpio_button_config.gpio_num = kButtons[index].gpio;
+    config.gpio_button_config.active_level = kButtons[index].active_level;
 
-    // To enable powersafe, a setting must be set first via menuconfig
-    // config.gpio_button_config.enable_power_save = true;
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    // Stop polling while released and wake on the GPIO level instead, so an idle switch can sleep.
+    config.gpio_button_config.enable_power_save = true;
+#endif
+#endif
 
     button_handle_t handle = iot_button_create(&config);
 
-    ESP_ERROR_CHECK(iot_button_register_cb(handle, BUTTON_PRESS_UP, app_driver_button_press_up_cb, NULL));
-    ESP_ERROR_CHECK(iot_button_register_cb(handle, BUTTON_LONG_PRESS_START, app_driver_button_long_press_start_cb, NULL));
-    ESP_ERROR_CHECK(iot_button_register_cb(handle, BUTTON_LONG_PRESS_HOLD, app_driver_button_dimming_cb, NULL));
-
-    // This event never seems to get raised.
-    ESP_ERROR_CHECK(iot_button_register_cb(handle, BUTTON_LONG_PRESS_UP, app_driver_button_long_press_up_cb, NULL));
-
-    /* Other initializations */
-    client::set_request_callback(app_driver_client_invoke_command_callback,
-                                 app_driver_client_group_invoke_command_callback, NULL);
+    // Only raw edges are taken from the button component; taps and holds are recognized by the gesture.
+    ESP_ERROR_CHECK(app_gesture_init(&sw->gesture, app_driver_gesture_cb, sw));
+    ESP_ERROR_CHECK(iot_button_register_cb(handle, BUTTON_PRESS_DOWN, app_driver_button_press_down_cb, sw));
+    ESP_ERROR_CHECK(iot_button_register_cb(handle, BUTTON_PRESS_UP, app_driver_button_press_up_cb, sw));
 
     return (app_driver_handle_t)handle;
 }
+#endif
+#endif
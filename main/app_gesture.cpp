@@ -0,0 +1,138 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <esp_log.h>
+
+#include <app_gesture.h>
+
+static const char *TAG = "app_gesture";
+
+typedef enum : uint8_t {
+    EVENT_PRESS = 0,
+    EVENT_RELEASE,
+    EVENT_TIMEOUT,
+} gesture_event_t;
+
+static constexpr uint8_t kNoGesture = 0xFF;
+
+typedef struct {
+    app_gesture_state_t from;
+    gesture_event_t event;
+    app_gesture_state_t to;
+    /* Up to two gestures reported on the transition, kNoGesture if unused */
+    uint8_t first;
+    uint8_t second;
+} gesture_transition_t;
+
+static const gesture_transition_t kTransitions[] = {
+    {APP_GESTURE_STATE_IDLE, EVENT_PRESS, APP_GESTURE_STATE_PRESSED, kNoGesture, kNoGesture},
+#if CONFIG_DIMMER_SWITCH_DOUBLE_TAP
+    {APP_GESTURE_STATE_PRESSED, EVENT_RELEASE, APP_GESTURE_STATE_WAIT_SECOND, kNoGesture, kNoGesture},
+#else
+    // Nothing can follow a tap, so report it straight away.
+    {APP_GESTURE_STATE_PRESSED, EVENT_RELEASE, APP_GESTURE_STATE_IDLE, APP_GESTURE_TAP, kNoGesture},
+#endif
+    {APP_GESTURE_STATE_PRESSED, EVENT_TIMEOUT, APP_GESTURE_STATE_HOLDING, APP_GESTURE_HOLD_START, kNoGesture},
+    {APP_GESTURE_STATE_WAIT_SECOND, EVENT_PRESS, APP_GESTURE_STATE_SECOND_PRESSED, kNoGesture, kNoGesture},
+    {APP_GESTURE_STATE_WAIT_SECOND, EVENT_TIMEOUT, APP_GESTURE_STATE_IDLE, APP_GESTURE_TAP, kNoGesture},
+    {APP_GESTURE_STATE_SECOND_PRESSED, EVENT_RELEASE, APP_GESTURE_STATE_IDLE, APP_GESTURE_DOUBLE_TAP, kNoGesture},
+    // Tap followed by a hold.
+    {APP_GESTURE_STATE_SECOND_PRESSED, EVENT_TIMEOUT, APP_GESTURE_STATE_HOLDING, APP_GESTURE_TAP, APP_GESTURE_HOLD_START},
+    {APP_GESTURE_STATE_HOLDING, EVENT_TIMEOUT, APP_GESTURE_STATE_HOLDING, APP_GESTURE_HOLD_TICK, kNoGesture},
+    {APP_GESTURE_STATE_HOLDING, EVENT_RELEASE, APP_GESTURE_STATE_IDLE, APP_GESTURE_HOLD_RELEASE, kNoGesture},
+};
+
+#if CONFIG_DIMMER_SWITCH_DOUBLE_TAP
+static constexpr uint32_t kDoubleTapWindowMs = CONFIG_DIMMER_SWITCH_DOUBLE_TAP_WINDOW_MS;
+#else
+static constexpr uint32_t kDoubleTapWindowMs = 0;
+#endif
+
+/* Timeout armed on entering each state, 0 for none. Indexed by app_gesture_state_t. */
+static const uint32_t kStateTimeoutMs[APP_GESTURE_STATE_MAX] = {
+    0,                                         // IDLE
+    CONFIG_DIMMER_SWITCH_HOLD_TIME_MS,         // PRESSED
+    kDoubleTapWindowMs,                        // WAIT_SECOND
+    CONFIG_DIMMER_SWITCH_HOLD_TIME_MS,         // SECOND_PRESSED
+    CONFIG_DIMMER_SWITCH_HOLD_TICK_MS,         // HOLDING
+};
+
+static void app_gesture_report(app_gesture_t *gesture, uint8_t type)
+{
+    if (type == kNoGesture) {
+        return;
+    }
+
+    app_gesture_event_t event = {};
+    event.type = static_cast<app_gesture_type_t>(type);
+    if (type == APP_GESTURE_HOLD_START) {
+        gesture->hold_count = 0;
+    } else if (type == APP_GESTURE_HOLD_TICK) {
+        gesture->hold_count++;
+    }
+    event.hold_count = gesture->hold_count;
+    event.hold_time_ms = static_cast<uint32_t>((esp_timer_get_time() - gesture->press_time) / 1000);
+    gesture->callback(&event, gesture->priv);
+}
+
+static void app_gesture_handle(app_gesture_t *gesture, gesture_event_t event)
+{
+    for (const gesture_transition_t &transition : kTransitions) {
+        if (transition.from != gesture->state || transition.event != event) {
+            continue;
+        }
+
+        esp_timer_stop(gesture->timer);
+        gesture->state = transition.to;
+        uint32_t timeout_ms = kStateTimeoutMs[transition.to];
+        if (timeout_ms > 0) {
+            esp_timer_start_once(gesture->timer, static_cast<uint64_t>(timeout_ms) * 1000);
+        }
+
+        app_gesture_report(gesture, transition.first);
+        app_gesture_report(gesture, transition.second);
+        return;
+    }
+
+    // Edges the table doesn't expect, e.g. a release whose press was missed, are dropped.
+    ESP_LOGD(TAG, "Ignoring event %d in state %d", event, gesture->state);
+}
+
+static void app_gesture_timer_cb(void *arg)
+{
+    app_gesture_handle(static_cast<app_gesture_t *>(arg), EVENT_TIMEOUT);
+}
+
+esp_err_t app_gesture_init(app_gesture_t *gesture, app_gesture_cb_t callback, void *priv)
+{
+    if (!gesture || !callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    gesture->state = APP_GESTURE_STATE_IDLE;
+    gesture->hold_count = 0;
+    gesture->press_time = 0;
+    gesture->callback = callback;
+    gesture->priv = priv;
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = app_gesture_timer_cb;
+    timer_args.arg = gesture;
+    timer_args.name = "gesture";
+    return esp_timer_create(&timer_args, &gesture->timer);
+}
+
+void app_gesture_press(app_gesture_t *gesture)
+{
+    gesture->press_time = esp_timer_get_time();
+    app_gesture_handle(gesture, EVENT_PRESS);
+}
+
+void app_gesture_release(app_gesture_t *gesture)
+{
+    app_gesture_handle(gesture, EVENT_RELEASE);
+}
@@ -0,0 +1,82 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <stdint.h>
+
+/* Gesture recognizer.
+ *
+ * Turns debounced press and release edges into taps, double taps and holds with a table
+ * driven state machine. Timeouts (hold threshold, double tap window, hold ticks) run on a
+ * one-shot esp_timer that is only armed while a gesture is in progress.
+ *
+ * With double tap disabled, a tap is reported on release without waiting for a second
+ * press, so a click adds no latency on top of debouncing. */
+
+typedef enum : uint8_t {
+    APP_GESTURE_TAP = 0,
+    APP_GESTURE_DOUBLE_TAP,
+    APP_GESTURE_HOLD_START,
+    APP_GESTURE_HOLD_TICK,
+    APP_GESTURE_HOLD_RELEASE,
+} app_gesture_type_t;
+
+typedef struct {
+    app_gesture_type_t type;
+    /* Hold ticks so far, starting at 1 on the first APP_GESTURE_HOLD_TICK */
+    uint16_t hold_count;
+    /* Time since the press that started the gesture */
+    uint32_t hold_time_ms;
+} app_gesture_event_t;
+
+/** Called from the esp_timer task for every recognized gesture */
+typedef void (*app_gesture_cb_t)(const app_gesture_event_t *event, void *priv);
+
+typedef enum : uint8_t {
+    APP_GESTURE_STATE_IDLE = 0,
+    APP_GESTURE_STATE_PRESSED,
+    APP_GESTURE_STATE_WAIT_SECOND,
+    APP_GESTURE_STATE_SECOND_PRESSED,
+    APP_GESTURE_STATE_HOLDING,
+    APP_GESTURE_STATE_MAX,
+} app_gesture_state_t;
+
+typedef struct {
+    app_gesture_state_t state;
+    uint16_t hold_count;
+    int64_t press_time;
+    esp_timer_handle_t timer;
+    app_gesture_cb_t callback;
+    void *priv;
+} app_gesture_t;
+
+/** Initialize a recognizer
+ *
+ * @param[in] gesture Recognizer to initialize, usually statically allocated.
+ * @param[in] callback Called for every recognized gesture.
+ * @param[in] priv Passed back to the callback.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_gesture_init(app_gesture_t *gesture, app_gesture_cb_t callback, void *priv);
+
+/** Feed a debounced press edge
+ *
+ * Must be called from the esp_timer task, where the button component runs its callbacks.
+ */
+void app_gesture_press(app_gesture_t *gesture);
+
+/** Feed a debounced release edge
+ *
+ * Must be called from the esp_timer task, where the button component runs its callbacks.
+ */
+void app_gesture_release(app_gesture_t *gesture);
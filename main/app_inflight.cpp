@@ -0,0 +1,490 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <esp_timer.h>
+
+#include <app-common/zap-generated/cluster-objects.h>
+#include <app/server/Server.h>
+#include <transport/SessionHolder.h>
+
+#include <app_command.h>
+#include <app_inflight.h>
+#include <app_log.h>
+#include <app_trace.h>
+
+using namespace chip;
+using namespace chip::app::Clusters;
+using namespace esp_matter;
+
+static const char *TAG = "app_inflight";
+
+static constexpr size_t kTableSize = CONFIG_DIMMER_SWITCH_INFLIGHT_TABLE_SIZE;
+static constexpr uint32_t kMinTimeoutMs = 500;
+static constexpr uint32_t kMaxTimeoutMs = CONFIG_DIMMER_SWITCH_INFLIGHT_TIMEOUT_MS;
+static constexpr uint8_t kRetryBudget = CONFIG_DIMMER_SWITCH_INFLIGHT_RETRY_BUDGET;
+
+// Copy of a command, kept so it can be sent after the request callback has returned.
+typedef struct {
+    CommandId command_id = kInvalidCommandId;
+    EndpointId endpoint_id = kInvalidEndpointId;
+    // Latency trace of the newest intent folded into the command, 0 when not traced.
+    uint16_t trace_id = 0;
+    // Toggles still to send after this one.
+    uint8_t repeat = 0;
+    LevelControl::Commands::Step::Type step;
+    LevelControl::Commands::Move::Type move;
+    LevelControl::Commands::Stop::Type stop;
+    LevelControl::Commands::MoveToLevelWithOnOff::Type move_to_level;
+} inflight_command_t;
+
+typedef struct {
+    ScopedNodeId peer;
+    ClusterId cluster_id = kInvalidClusterId;
+    bool in_use = false;
+    bool busy = false;
+    bool has_pending = false;
+    uint8_t retry_budget = kRetryBudget;
+    // Sequence of the invoke in flight; completions carrying another one are stale.
+    uint16_t sequence = 0;
+    // Smoothed round trip time, 0 until the first ack.
+    uint32_t srtt_ms = 0;
+    int64_t sent_time = 0;
+    SessionHolder session;
+    inflight_command_t sent;
+    inflight_command_t pending;
+} inflight_entry_t;
+
+// A command for a peer that found every entry taken. It waits here, merging with newer commands
+// for the same peer, until an entry becomes idle.
+typedef struct {
+    ScopedNodeId peer;
+    ClusterId cluster_id = kInvalidClusterId;
+    bool in_use = false;
+    // Order of arrival; the oldest waiter gets the next idle entry.
+    uint32_t order = 0;
+    SessionHolder session;
+    inflight_command_t command;
+} inflight_waiter_t;
+
+static inflight_entry_t s_entries[kTableSize];
+static inflight_waiter_t s_waiters[kTableSize];
+static app_inflight_stats_t s_stats;
+static uint16_t s_next_sequence = 0;
+static uint32_t s_next_waiter_order = 0;
+
+template <typename CommandType>
+static void app_inflight_store(inflight_command_t *command, const CommandType &)
+{
+    command->command_id = CommandType::GetCommandId();
+}
+
+static void app_inflight_store(inflight_command_t *command, const LevelControl::Commands::Step::Type &step)
+{
+    command->command_id = LevelControl::Commands::Step::Id;
+    command->step = step;
+}
+
+static void app_inflight_store(inflight_command_t *command, const LevelControl::Commands::Move::Type &move)
+{
+    command->command_id = LevelControl::Commands::Move::Id;
+    command->move = move;
+}
+
+static void app_inflight_store(inflight_command_t *command, const LevelControl::Commands::Stop::Type &stop)
+{
+    command->command_id = LevelControl::Commands::Stop::Id;
+    command->stop = stop;
+}
+
+static void app_inflight_store(inflight_command_t *command,
+                               const LevelControl::Commands::MoveToLevelWithOnOff::Type &move_to_level)
+{
+    command->command_id = LevelControl::Commands::MoveToLevelWithOnOff::Id;
+    command->move_to_level = move_to_level;
+}
+
+static const void *app_inflight_payload(ClusterId cluster_id, const inflight_command_t *command)
+{
+    if (cluster_id != LevelControl::Id) {
+        return nullptr;
+    }
+    switch (command->command_id) {
+    case LevelControl::Commands::Step::Id:
+        return &command->step;
+    case LevelControl::Commands::Move::Id:
+        return &command->move;
+    case LevelControl::Commands::Stop::Id:
+        return &command->stop;
+    case LevelControl::Commands::MoveToLevelWithOnOff::Id:
+        return &command->move_to_level;
+    default:
+        return nullptr;
+    }
+}
+
+// Commands that leave the light in the same state however many times they arrive.
+static bool app_inflight_idempotent(ClusterId cluster_id, CommandId command_id)
+{
+    if (cluster_id == OnOff::Id) {
+        return command_id != OnOff::Commands::Toggle::Id;
+    }
+    return command_id != LevelControl::Commands::Step::Id;
+}
+
+static uint32_t app_inflight_timeout_ms(const inflight_entry_t *entry)
+{
+    if (entry->srtt_ms == 0) {
+        return kMaxTimeoutMs;
+    }
+    uint32_t timeout_ms = entry->srtt_ms * 4;
+    return timeout_ms < kMinTimeoutMs ? kMinTimeoutMs : (timeout_ms > kMaxTimeoutMs ? kMaxTimeoutMs : timeout_ms);
+}
+
+static esp_err_t app_inflight_transmit(inflight_entry_t *entry, const inflight_command_t *command)
+{
+    Optional<SessionHandle> session = entry->session.Get();
+    if (!session.HasValue()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    client::request_handle_t req_handle;
+    req_handle.type = client::INVOKE_CMD;
+    req_handle.command_path.mClusterId = entry->cluster_id;
+    req_handle.command_path.mCommandId = command->command_id;
+    req_handle.command_path.mEndpointId = command->endpoint_id;
+    req_handle.request_data = const_cast<void *>(app_inflight_payload(entry->cluster_id, command));
+
+    Optional<System::Clock::Timeout> timeout = MakeOptional<System::Clock::Timeout>(
+                                                   System::Clock::Milliseconds32(app_inflight_timeout_ms(entry)));
+    // 0 marks untracked sends, so it is skipped when the counter wraps.
+    uint16_t sequence = ++s_next_sequence == 0 ? ++s_next_sequence : s_next_sequence;
+    esp_err_t err = app_command_dispatch(&req_handle, [&](const auto &typed_command) {
+        return app_command_send(&Server::GetInstance().GetExchangeManager(), session.Value(), entry->peer.GetNodeId(),
+                                command->endpoint_id, typed_command, timeout, sequence);
+    });
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (command != &entry->sent) {
+        entry->sent = *command;
+    }
+    entry->busy = true;
+    entry->sequence = sequence;
+    entry->sent_time = esp_timer_get_time();
+    s_stats.sent++;
+    app_trace_send(command->trace_id, entry->peer, entry->cluster_id);
+    return ESP_OK;
+}
+
+// Folds a new command into one that is waiting to be sent. Returns false if the two cancel out
+// and nothing is left to send.
+static bool app_inflight_fold(ClusterId cluster_id, inflight_command_t *pending, const inflight_command_t *command)
+{
+    s_stats.superseded++;
+    pending->trace_id = command->trace_id;
+
+    if (cluster_id == OnOff::Id && command->command_id == OnOff::Commands::Toggle::Id) {
+        switch (pending->command_id) {
+        case OnOff::Commands::Toggle::Id:
+            // Every press the user made is sent, in order, once the light has taken the earlier ones.
+            if (pending->repeat < UINT8_MAX) {
+                pending->repeat++;
+            }
+            return true;
+        case OnOff::Commands::On::Id:
+            pending->command_id = OnOff::Commands::Off::Id;
+            return true;
+        case OnOff::Commands::Off::Id:
+            pending->command_id = OnOff::Commands::On::Id;
+            return true;
+        default:
+            break;
+        }
+    }
+
+    if (cluster_id == LevelControl::Id && pending->command_id == LevelControl::Commands::Step::Id &&
+        command->command_id == LevelControl::Commands::Step::Id) {
+        // Relative steps add up; the newer step keeps its transition time.
+        int net = (pending->step.stepMode == LevelControl::StepModeEnum::kUp ? 1 : -1) * pending->step.stepSize +
+                  (command->step.stepMode == LevelControl::StepModeEnum::kUp ? 1 : -1) * command->step.stepSize;
+        if (net == 0) {
+            return false;
+        }
+        LevelControl::Commands::Step::Type merged = command->step;
+        merged.stepMode = net > 0 ? LevelControl::StepModeEnum::kUp : LevelControl::StepModeEnum::kDown;
+        merged.stepSize = static_cast<uint8_t>((net > 0 ? net : -net) > 254 ? 254 : (net > 0 ? net : -net));
+        pending->step = merged;
+        return true;
+    }
+
+    if (cluster_id == LevelControl::Id && pending->command_id == LevelControl::Commands::MoveToLevelWithOnOff::Id &&
+        command->command_id == LevelControl::Commands::Step::Id) {
+        // A step after an absolute level that never went out moves that level instead.
+        int level = pending->move_to_level.level +
+                    (command->step.stepMode == LevelControl::StepModeEnum::kUp ? 1 : -1) * command->step.stepSize;
+        pending->move_to_level.level = static_cast<uint8_t>(level < 1 ? 1 : (level > 254 ? 254 : level));
+        pending->move_to_level.transitionTime = command->step.transitionTime;
+        return true;
+    }
+
+    // Absolute commands simply replace what was waiting.
+    *pending = *command;
+    return true;
+}
+
+// Parks a new command in the pending slot of a busy entry.
+static void app_inflight_supersede(inflight_entry_t *entry, const inflight_command_t *command)
+{
+    if (!entry->has_pending) {
+        entry->pending = *command;
+        entry->has_pending = true;
+        return;
+    }
+    entry->has_pending = app_inflight_fold(entry->cluster_id, &entry->pending, command);
+}
+
+// Sends the command parked on an entry whose previous invoke is done. A run of toggles goes out
+// one at a time, so the rest stays parked.
+static void app_inflight_send_pending(inflight_entry_t *entry)
+{
+    inflight_command_t command = entry->pending;
+    command.repeat = 0;
+    if (entry->pending.repeat > 0) {
+        entry->pending.repeat--;
+    } else {
+        entry->has_pending = false;
+    }
+    if (app_inflight_transmit(entry, &command) != ESP_OK) {
+        entry->has_pending = false;
+        s_stats.dropped++;
+    }
+}
+
+static inflight_entry_t *app_inflight_find(const ScopedNodeId &peer, ClusterId cluster_id)
+{
+    for (inflight_entry_t &entry : s_entries) {
+        if (entry.in_use && entry.peer == peer && entry.cluster_id == cluster_id) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// An answer that never came is treated as lost. Should it still turn up, its sequence no longer
+// matches and it is ignored, and the entry moves on to its parked command.
+static void app_inflight_reclaim(inflight_entry_t *entry)
+{
+    if (!entry->busy || (esp_timer_get_time() - entry->sent_time) / 1000 <= 2 * app_inflight_timeout_ms(entry)) {
+        return;
+    }
+    entry->busy = false;
+    if (entry->has_pending) {
+        app_inflight_send_pending(entry);
+    }
+}
+
+static inflight_entry_t *app_inflight_alloc(const ScopedNodeId &peer, ClusterId cluster_id)
+{
+    inflight_entry_t *idle = nullptr;
+    for (inflight_entry_t &entry : s_entries) {
+        if (!entry.in_use) {
+            idle = &entry;
+            break;
+        }
+        app_inflight_reclaim(&entry);
+        if (!entry.busy && !entry.has_pending && idle == nullptr) {
+            idle = &entry;
+        }
+    }
+    if (idle == nullptr) {
+        return nullptr;
+    }
+
+    idle->session.Release();
+    idle->peer = peer;
+    idle->cluster_id = cluster_id;
+    idle->in_use = true;
+    idle->busy = false;
+    idle->has_pending = false;
+    idle->retry_budget = kRetryBudget;
+    idle->srtt_ms = 0;
+    return idle;
+}
+
+static inflight_waiter_t *app_inflight_find_waiter(const ScopedNodeId &peer, ClusterId cluster_id)
+{
+    for (inflight_waiter_t &waiter : s_waiters) {
+        if (waiter.in_use && waiter.peer == peer && waiter.cluster_id == cluster_id) {
+            return &waiter;
+        }
+    }
+    return nullptr;
+}
+
+static void app_inflight_free_waiter(inflight_waiter_t *waiter)
+{
+    waiter->in_use = false;
+    waiter->session.Release();
+}
+
+// Hands idle entries to the peers waiting for one, oldest first.
+static void app_inflight_serve_waiters()
+{
+    while (true) {
+        inflight_waiter_t *oldest = nullptr;
+        for (inflight_waiter_t &waiter : s_waiters) {
+            if (waiter.in_use && (oldest == nullptr || static_cast<int32_t>(waiter.order - oldest->order) < 0)) {
+                oldest = &waiter;
+            }
+        }
+        if (oldest == nullptr) {
+            return;
+        }
+
+        Optional<SessionHandle> session = oldest->session.Get();
+        if (!session.HasValue()) {
+            s_stats.dropped++;
+            app_inflight_free_waiter(oldest);
+            continue;
+        }
+        inflight_entry_t *entry = app_inflight_alloc(oldest->peer, oldest->cluster_id);
+        if (entry == nullptr) {
+            return;
+        }
+        entry->session.Grab(session.Value());
+        entry->pending = oldest->command;
+        entry->has_pending = true;
+        app_inflight_free_waiter(oldest);
+        app_inflight_send_pending(entry);
+    }
+}
+
+esp_err_t app_inflight_send(client::peer_device_t *peer_device, const client::request_handle_t *req_handle,
+                            uint16_t trace_id)
+{
+    ClusterId cluster_id = req_handle->command_path.mClusterId;
+    EndpointId endpoint_id = req_handle->command_path.mEndpointId;
+
+    Optional<SessionHandle> session = peer_device->GetSecureSession();
+    if (!session.HasValue()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ScopedNodeId peer(peer_device->GetDeviceId(), session.Value()->GetFabricIndex());
+    auto send_now = [&](const auto &command) {
+        esp_err_t err = app_command_send(peer_device, endpoint_id, command);
+        if (err == ESP_OK) {
+            app_trace_send(trace_id, peer, cluster_id);
+        }
+        return err;
+    };
+
+    // Only the clusters the switch drives continuously are tracked.
+    if (cluster_id != OnOff::Id && cluster_id != LevelControl::Id) {
+        return app_command_dispatch(req_handle, send_now);
+    }
+
+    inflight_command_t command;
+    esp_err_t err = app_command_dispatch(req_handle, [&](const auto &typed_command) {
+        app_inflight_store(&command, typed_command);
+        return ESP_OK;
+    });
+    if (err != ESP_OK) {
+        return err;
+    }
+    command.endpoint_id = endpoint_id;
+    command.trace_id = trace_id;
+
+    inflight_entry_t *entry = app_inflight_find(peer, cluster_id);
+    if (entry == nullptr) {
+        inflight_waiter_t *waiter = app_inflight_find_waiter(peer, cluster_id);
+        if (waiter != nullptr) {
+            if (!app_inflight_fold(cluster_id, &waiter->command, &command)) {
+                app_inflight_free_waiter(waiter);
+            }
+            app_inflight_serve_waiters();
+            return ESP_OK;
+        }
+        entry = app_inflight_alloc(peer, cluster_id);
+    }
+    if (entry == nullptr) {
+        // Every entry is waiting on a peer. Only this peer's commands wait for one to become
+        // idle; the other peers keep going.
+        s_stats.backpressure++;
+        inflight_waiter_t *waiter = nullptr;
+        for (inflight_waiter_t &free_waiter : s_waiters) {
+            if (!free_waiter.in_use) {
+                waiter = &free_waiter;
+                break;
+            }
+        }
+        if (waiter == nullptr) {
+            // No room to wait either, so it goes out untracked.
+            return app_command_dispatch(req_handle, send_now);
+        }
+        waiter->peer = peer;
+        waiter->cluster_id = cluster_id;
+        waiter->in_use = true;
+        waiter->order = s_next_waiter_order++;
+        waiter->session.Grab(session.Value());
+        waiter->command = command;
+        return ESP_OK;
+    }
+
+    app_inflight_reclaim(entry);
+    if (entry->busy) {
+        app_inflight_supersede(entry, &command);
+        return ESP_OK;
+    }
+
+    entry->session.Grab(session.Value());
+    return app_inflight_transmit(entry, &command);
+}
+
+bool app_inflight_complete(const ScopedNodeId &peer, ClusterId cluster_id, uint16_t sequence, CHIP_ERROR error)
+{
+    if (sequence == 0) {
+        app_trace_complete(peer, cluster_id, error == CHIP_NO_ERROR);
+        return true;
+    }
+    inflight_entry_t *entry = app_inflight_find(peer, cluster_id);
+    if (entry == nullptr || !entry->busy || entry->sequence != sequence) {
+        return false;
+    }
+    entry->busy = false;
+    app_trace_complete(peer, cluster_id, error == CHIP_NO_ERROR);
+
+    if (error == CHIP_NO_ERROR) {
+        uint32_t rtt_ms = static_cast<uint32_t>((esp_timer_get_time() - entry->sent_time) / 1000);
+        entry->srtt_ms = entry->srtt_ms == 0 ? rtt_ms : entry->srtt_ms - entry->srtt_ms / 8 + rtt_ms / 8;
+        if (entry->retry_budget < kRetryBudget) {
+            entry->retry_budget++;
+        }
+    } else if (error == CHIP_ERROR_TIMEOUT) {
+        s_stats.timeouts++;
+    }
+
+    if (entry->has_pending) {
+        app_inflight_send_pending(entry);
+    } else if (error != CHIP_NO_ERROR && !error.IsIMStatus() &&
+               app_inflight_idempotent(cluster_id, entry->sent.command_id) && entry->retry_budget > 0) {
+        // Lost on the way, not rejected by the light.
+        entry->retry_budget--;
+        s_stats.retries++;
+        APP_LOGW(TAG, "Retrying command 0x%lx to 0x%llx", entry->sent.command_id, peer.GetNodeId());
+        app_inflight_transmit(entry, &entry->sent);
+    }
+
+    app_inflight_serve_waiters();
+    return true;
+}
+
+void app_inflight_get_stats(app_inflight_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,81 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <esp_matter_client.h>
+#include <stdint.h>
+
+#include <lib/core/CHIPError.h>
+#include <lib/core/DataModelTypes.h>
+#include <lib/core/ScopedNodeId.h>
+
+/* In-flight request table.
+ *
+ * At most one OnOff and one LevelControl invoke is outstanding per peer. A command for a
+ * peer that is still busy waits in a single pending slot, where a newer command supersedes
+ * or merges with the one already there, so a slow light never builds a queue and never
+ * receives a stale Step after a newer one. Toggles can't merge and are counted instead, so
+ * every press still reaches the light. Response timeouts follow each peer's measured
+ * round trip time, and idempotent commands that time out are retried within a per-peer
+ * budget. A peer that finds every entry busy waits, with its commands merging the same way,
+ * until any entry becomes idle; the other peers are not held up. */
+
+typedef struct {
+    /* Invokes put on the wire */
+    uint32_t sent;
+    /* Commands that replaced or merged with a pending one */
+    uint32_t superseded;
+    uint32_t timeouts;
+    uint32_t retries;
+    /* Pending commands dropped because the session went away */
+    uint32_t dropped;
+    /* Commands that found every entry busy */
+    uint32_t backpressure;
+} app_inflight_stats_t;
+
+/** Send a command to a peer, or park it behind the one in flight
+ *
+ * The latency trace records the send when the command actually goes on the wire, not when
+ * it is parked. Must be called in the Matter thread, from the client invoke callback.
+ *
+ * @param[in] peer_device Peer with an established CASE session.
+ * @param[in] req_handle Request passed to the client invoke callback.
+ * @param[in] trace_id Latency trace of the intent being sent, 0 when not traced.
+ *
+ * @return ESP_OK if the command was sent or parked.
+ * @return error in case of failure.
+ */
+esp_err_t app_inflight_send(esp_matter::client::peer_device_t *peer_device,
+                            const esp_matter::client::request_handle_t *req_handle, uint16_t trace_id);
+
+/** Complete the invoke in flight to a peer
+ *
+ * Records the outcome in the latency trace, then sends the pending command if there is one,
+ * or retries the completed one if it timed out and the peer has retry budget left. Entries
+ * left idle go to the peers waiting for one. A
+ * completion whose sequence doesn't match the command in flight belongs to an earlier send
+ * that was given up on, and is ignored. Must be called in the Matter thread.
+ *
+ * @param[in] peer Peer that answered, with the fabric the command was sent on.
+ * @param[in] cluster_id Cluster of the command.
+ * @param[in] sequence Sequence number passed to the completion callback.
+ * @param[in] error CHIP_NO_ERROR on success, the failure otherwise.
+ *
+ * @return true if the completion was for the command in flight or for an untracked send.
+ * @return false if it was stale.
+ */
+bool app_inflight_complete(const chip::ScopedNodeId &peer, chip::ClusterId cluster_id, uint16_t sequence,
+                           CHIP_ERROR error);
+
+/** Read the table counters
+ *
+ * @param[out] stats Counters since boot.
+ */
+void app_inflight_get_stats(app_inflight_stats_t *stats);
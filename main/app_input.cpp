@@ -0,0 +1,109 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_GPIO_INTERRUPT
+
+#include <esp_log.h>
+#include <esp_sleep.h>
+
+#include <app_input.h>
+
+static const char *TAG = "app_input";
+
+static constexpr uint64_t kDebounceUs = CONFIG_DIMMER_SWITCH_DEBOUNCE_MS * 1000ULL;
+
+static void app_input_arm(app_input_t *input)
+{
+    // Level triggered rather than edge triggered, so a change that happened while the
+    // interrupt was masked still fires as soon as it is unmasked.
+    bool wait_high = input->pressed ? !input->active_level : input->active_level;
+    gpio_int_type_t type = wait_high ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL;
+    gpio_set_intr_type(input->gpio, type);
+#if CONFIG_PM_ENABLE
+    gpio_wakeup_enable(input->gpio, type);
+#endif
+    gpio_intr_enable(input->gpio);
+}
+
+static void app_input_isr(void *arg)
+{
+    app_input_t *input = static_cast<app_input_t *>(arg);
+
+    // Masked until the debounce timer has sampled the pin, so a bouncing contact costs one
+    // interrupt per debounced edge.
+    gpio_intr_disable(input->gpio);
+    esp_timer_start_once(input->timer, kDebounceUs);
+}
+
+static void app_input_debounce_cb(void *arg)
+{
+    app_input_t *input = static_cast<app_input_t *>(arg);
+
+    // A glitch shorter than the debounce time leaves the pin where it was and is ignored.
+    bool pressed = gpio_get_level(input->gpio) == input->active_level;
+    if (pressed != input->pressed) {
+        input->pressed = pressed;
+        input->callback(pressed, input->priv);
+    }
+    app_input_arm(input);
+}
+
+esp_err_t app_input_init(app_input_t *input, gpio_num_t gpio, uint8_t active_level, app_input_cb_t callback,
+                         void *priv)
+{
+    if (!input || !callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    input->gpio = gpio;
+    input->active_level = active_level;
+    // A button held through boot is reported as a press once the input is armed.
+    input->pressed = false;
+    input->callback = callback;
+    input->priv = priv;
+
+    gpio_config_t io_config = {};
+    io_config.pin_bit_mask = 1ULL << gpio;
+    io_config.mode = GPIO_MODE_INPUT;
+    io_config.pull_up_en = active_level ? GPIO_PULLUP_DISABLE : GPIO_PULLUP_ENABLE;
+    io_config.pull_down_en = active_level ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE;
+    io_config.intr_type = GPIO_INTR_DISABLE;
+    esp_err_t err = gpio_config(&io_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = app_input_debounce_cb;
+    timer_args.arg = input;
+    timer_args.name = "debounce";
+    err = esp_timer_create(&timer_args, &input->timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Shared by all inputs, and possibly already installed by another component.
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install the GPIO ISR service, err:%d", err);
+        return err;
+    }
+#if CONFIG_PM_ENABLE
+    esp_sleep_enable_gpio_wakeup();
+#endif
+
+    err = gpio_isr_handler_add(gpio, app_input_isr, input);
+    if (err != ESP_OK) {
+        return err;
+    }
+    app_input_arm(input);
+    return ESP_OK;
+}
+
+#endif // CONFIG_DIMMER_SWITCH_GPIO_INTERRUPT
@@ -0,0 +1,50 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <driver/gpio.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <stdint.h>
+
+/* Interrupt driven button input.
+ *
+ * The pin interrupt waits for the level opposite to the debounced state. When it fires, the
+ * ISR masks it and arms a one-shot debounce timer, which samples the pin, reports a change
+ * and waits for the next one. Nothing runs while the button is left alone, and the same
+ * level is used as the light sleep wakeup source, so an idle switch can sleep until pressed. */
+
+/** Called from the esp_timer task for every debounced edge */
+typedef void (*app_input_cb_t)(bool pressed, void *priv);
+
+typedef struct {
+    gpio_num_t gpio;
+    uint8_t active_level;
+    /* Debounced state, only touched in the esp_timer task */
+    bool pressed;
+    esp_timer_handle_t timer;
+    app_input_cb_t callback;
+    void *priv;
+} app_input_t;
+
+/** Initialize an input
+ *
+ * Configures the pin, with a pull towards the released level, and starts waiting for a press.
+ *
+ * @param[in] input Input to initialize, usually statically allocated.
+ * @param[in] gpio Button pin.
+ * @param[in] active_level Pin level while the button is pressed.
+ * @param[in] callback Called for every debounced press and release.
+ * @param[in] priv Passed back to the callback.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_input_init(app_input_t *input, gpio_num_t gpio, uint8_t active_level, app_input_cb_t callback,
+                         void *priv);
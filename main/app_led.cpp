@@ -0,0 +1,287 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_LED
+
+#include <atomic>
+
+#include <driver/ledc.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+#include <app_led.h>
+#include <app_priv.h>
+
+static const char *TAG = "app_led";
+
+static constexpr ledc_mode_t kMode = LEDC_LOW_SPEED_MODE;
+static constexpr ledc_channel_t kChannel = LEDC_CHANNEL_0;
+static constexpr ledc_timer_t kTimer = LEDC_TIMER_0;
+static constexpr ledc_timer_bit_t kResolution = LEDC_TIMER_13_BIT;
+static constexpr uint32_t kMaxDuty = (1 << 13) - 1;
+static constexpr uint32_t kFrequencyHz = 5000;
+// Fade out when the last effect ends.
+static constexpr uint16_t kIdleFadeMs = 200;
+
+// Keyframe brightness standing for the level passed to app_led_show_level().
+static constexpr uint8_t kParam = 0xFF;
+// Repeat count of effects that run until replaced or cleared.
+static constexpr uint8_t kForever = 0;
+
+typedef struct {
+    uint8_t brightness;
+    uint16_t fade_ms;
+    uint16_t hold_ms;
+} led_keyframe_t;
+
+typedef struct {
+    const led_keyframe_t *frames;
+    uint8_t count;
+    uint8_t repeat;
+} led_effect_t;
+
+static constexpr led_keyframe_t kBlink[] = {{255, 0, 500}, {0, 0, 500}};
+static constexpr led_keyframe_t kBreathe[] = {{255, 500, 0}, {0, 500, 0}};
+static constexpr led_keyframe_t kOkay[] = {{255, 0, 150}, {0, 0, 150}};
+static constexpr led_keyframe_t kChannelChange[] = {{255, 0, 500}, {16, 0, 7500}, {0, 0, 0}};
+static constexpr led_keyframe_t kIdentify[] = {{255, 0, 500}, {0, 0, 500}};
+static constexpr led_keyframe_t kCommissioning[] = {{96, 1500, 0}, {8, 1500, 0}};
+static constexpr led_keyframe_t kLevel[] = {{kParam, 150, 1000}, {0, 500, 0}};
+
+#define LED_EFFECT(frames, repeat) {frames, sizeof(frames) / sizeof(frames[0]), repeat}
+
+// Indexed by app_led_effect_t. Identify effect timings follow the Identify cluster.
+static const led_effect_t kEffects[APP_LED_EFFECT_MAX] = {
+    {nullptr, 0, 0},
+    LED_EFFECT(kBlink, 1),
+    LED_EFFECT(kBreathe, 15),
+    LED_EFFECT(kOkay, 2),
+    LED_EFFECT(kChannelChange, 1),
+    LED_EFFECT(kIdentify, kForever),
+    LED_EFFECT(kCommissioning, kForever),
+    LED_EFFECT(kLevel, 1),
+};
+
+// Requests from any task: the effect in the low byte, the level parameter in the next one and
+// a sequence number above, so the same effect played again restarts.
+static std::atomic<uint32_t> s_requests[APP_LED_LAYER_MAX];
+static std::atomic<uint16_t> s_sequence{0};
+
+// Playback state, only touched in the esp_timer task.
+typedef struct {
+    uint32_t request;
+    uint8_t frame;
+    uint8_t repeats_left;
+    bool done;
+} led_layer_t;
+
+static led_layer_t s_layers[APP_LED_LAYER_MAX];
+static int s_shown_layer = -1;
+// When the keyframe of the shown layer has played out.
+static int64_t s_frame_end_us = 0;
+static esp_timer_handle_t s_timer = nullptr;
+#if CONFIG_PM_ENABLE
+// LEDC stops in light sleep, so sleep is held off while an effect plays.
+static esp_pm_lock_handle_t s_pm_lock = nullptr;
+#endif
+
+static uint32_t app_led_duty(uint8_t brightness)
+{
+    // Squared for a roughly perceptual ramp.
+    return brightness * brightness * kMaxDuty / (255 * 255);
+}
+
+static void app_led_fade(uint8_t brightness, uint16_t fade_ms)
+{
+    ledc_fade_stop(kMode, kChannel);
+    if (fade_ms == 0) {
+        ledc_set_duty(kMode, kChannel, app_led_duty(brightness));
+        ledc_update_duty(kMode, kChannel);
+    } else {
+        ledc_set_fade_time_and_start(kMode, kChannel, app_led_duty(brightness), fade_ms, LEDC_FADE_NO_WAIT);
+    }
+}
+
+static void app_led_set_active(bool active)
+{
+#if CONFIG_PM_ENABLE
+    static bool s_active = false;
+    if (active != s_active) {
+        s_active = active;
+        if (active) {
+            esp_pm_lock_acquire(s_pm_lock);
+        } else {
+            esp_pm_lock_release(s_pm_lock);
+        }
+    }
+#endif
+}
+
+static void app_led_render(const led_layer_t *layer)
+{
+    const led_effect_t *effect = &kEffects[layer->request & 0xFF];
+    const led_keyframe_t *frame = &effect->frames[layer->frame];
+    uint8_t brightness = frame->brightness == kParam ? (layer->request >> 8) & 0xFF : frame->brightness;
+    app_led_fade(brightness, frame->fade_ms);
+
+    uint64_t duration_us = (frame->fade_ms + frame->hold_ms) * 1000ULL;
+    s_frame_end_us = esp_timer_get_time() + duration_us;
+    esp_timer_start_once(s_timer, duration_us);
+}
+
+static void app_led_timer_cb(void *arg)
+{
+    // Pick up new requests.
+    for (int i = 0; i < APP_LED_LAYER_MAX; i++) {
+        uint32_t request = s_requests[i].load(std::memory_order_acquire);
+        if (request != s_layers[i].request) {
+            led_layer_t *layer = &s_layers[i];
+            layer->request = request;
+            layer->frame = 0;
+            layer->repeats_left = kEffects[request & 0xFF].repeat;
+            layer->done = (request & 0xFF) == APP_LED_EFFECT_NONE;
+            if (i == s_shown_layer) {
+                s_shown_layer = -1;
+            }
+        }
+    }
+
+    // Only move on once the shown keyframe has played out, not on every kick.
+    bool advanced = false;
+    if (s_shown_layer >= 0 && esp_timer_get_time() >= s_frame_end_us) {
+        led_layer_t *shown = &s_layers[s_shown_layer];
+        if (++shown->frame == kEffects[shown->request & 0xFF].count) {
+            shown->frame = 0;
+            if (shown->repeats_left != kForever && --shown->repeats_left == 0) {
+                // Its last keyframe has ended, so the next layer down takes over.
+                shown->done = true;
+            }
+        }
+        advanced = true;
+    }
+
+    int top = -1;
+    for (int i = APP_LED_LAYER_MAX - 1; i >= 0; i--) {
+        if (!s_layers[i].done) {
+            top = i;
+            break;
+        }
+    }
+    if (top < 0) {
+        app_led_fade(0, kIdleFadeMs);
+        app_led_set_active(false);
+        s_shown_layer = -1;
+        return;
+    }
+
+    led_layer_t *layer = &s_layers[top];
+    if (top != s_shown_layer) {
+        // A layer uncovered by a finished one starts its effect over.
+        layer->frame = 0;
+        s_shown_layer = top;
+    } else if (!advanced) {
+        // Kicked for a layer underneath; the shown keyframe carries on for the rest of its time.
+        int64_t remaining_us = s_frame_end_us - esp_timer_get_time();
+        esp_timer_start_once(s_timer, remaining_us > 0 ? remaining_us : 0);
+        return;
+    }
+    app_led_set_active(true);
+    app_led_render(layer);
+}
+
+static void app_led_kick()
+{
+    // Runs the timer callback right away. If another task kicks at the same time, one of the
+    // starts fails and the other one still picks up both requests.
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, 0);
+}
+
+esp_err_t app_led_init()
+{
+    if (app_driver_gpio_in_use(CONFIG_DIMMER_SWITCH_LED_GPIO)) {
+        ESP_LOGE(TAG, "LED GPIO %d is already used by a button", CONFIG_DIMMER_SWITCH_LED_GPIO);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ledc_timer_config_t timer_config = {};
+    timer_config.speed_mode = kMode;
+    timer_config.duty_resolution = kResolution;
+    timer_config.timer_num = kTimer;
+    timer_config.freq_hz = kFrequencyHz;
+    timer_config.clk_cfg = LEDC_AUTO_CLK;
+    esp_err_t err = ledc_timer_config(&timer_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ledc_channel_config_t channel_config = {};
+    channel_config.gpio_num = CONFIG_DIMMER_SWITCH_LED_GPIO;
+    channel_config.speed_mode = kMode;
+    channel_config.channel = kChannel;
+    channel_config.timer_sel = kTimer;
+    channel_config.duty = 0;
+#if CONFIG_DIMMER_SWITCH_LED_ACTIVE_LOW
+    channel_config.flags.output_invert = 1;
+#endif
+    err = ledc_channel_config(&channel_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = ledc_fade_func_install(0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install LEDC fade, err:%d", err);
+        return err;
+    }
+
+#if CONFIG_PM_ENABLE
+    err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "led", &s_pm_lock);
+    if (err != ESP_OK) {
+        return err;
+    }
+#endif
+
+    for (int i = 0; i < APP_LED_LAYER_MAX; i++) {
+        s_layers[i].done = true;
+    }
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = app_led_timer_cb;
+    timer_args.name = "led";
+    return esp_timer_create(&timer_args, &s_timer);
+}
+
+static void app_led_request(app_led_layer_t layer, app_led_effect_t effect, uint8_t param)
+{
+    if (!s_timer || layer >= APP_LED_LAYER_MAX || effect >= APP_LED_EFFECT_MAX) {
+        return;
+    }
+    uint32_t sequence = s_sequence.fetch_add(1, std::memory_order_relaxed) + 1;
+    s_requests[layer].store(sequence << 16 | param << 8 | effect, std::memory_order_release);
+    app_led_kick();
+}
+
+void app_led_play(app_led_layer_t layer, app_led_effect_t effect)
+{
+    app_led_request(layer, effect, 0);
+}
+
+void app_led_show_level(uint8_t level)
+{
+    // Never fully dark, so the lowest levels still show.
+    uint8_t brightness = 16 + static_cast<uint32_t>(level) * (255 - 16) / 254;
+    app_led_request(APP_LED_LAYER_FEEDBACK, APP_LED_EFFECT_LEVEL, brightness);
+}
+
+#endif // CONFIG_DIMMER_SWITCH_LED
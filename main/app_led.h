@@ -0,0 +1,84 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+#include <stdint.h>
+
+/* Feedback LED.
+ *
+ * Effects are constant keyframe tables: a brightness, the time the LEDC hardware takes to fade
+ * to it, and how long it is held. A single one-shot esp_timer steps through the keyframes, so
+ * the CPU only runs once per keyframe and never per frame. Effects play on layers, and the
+ * highest layer with an effect running is shown: Identify above local feedback above the
+ * commissioning state. Requests only store the effect and kick the timer, so they are cheap
+ * from any task. */
+
+typedef enum : uint8_t {
+    APP_LED_EFFECT_NONE = 0,
+    /* Identify effects */
+    APP_LED_EFFECT_BLINK,
+    APP_LED_EFFECT_BREATHE,
+    APP_LED_EFFECT_OKAY,
+    APP_LED_EFFECT_CHANNEL_CHANGE,
+    /* Blinks until stopped, for the length of an Identify */
+    APP_LED_EFFECT_IDENTIFY,
+    /* Slow pulse while the commissioning window is open */
+    APP_LED_EFFECT_COMMISSIONING,
+    /* Brightness echo of a light level, see app_led_show_level() */
+    APP_LED_EFFECT_LEVEL,
+    APP_LED_EFFECT_MAX,
+} app_led_effect_t;
+
+typedef enum : uint8_t {
+    APP_LED_LAYER_STATE = 0,
+    APP_LED_LAYER_FEEDBACK,
+    APP_LED_LAYER_IDENTIFY,
+    APP_LED_LAYER_MAX,
+} app_led_layer_t;
+
+#if CONFIG_DIMMER_SWITCH_LED
+
+/** Initialize the LED
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_led_init();
+
+/** Play an effect on a layer
+ *
+ * Replaces the effect of the layer, restarting it if it is the same one. Safe to call from
+ * any task.
+ *
+ * @param[in] layer Layer to play on.
+ * @param[in] effect Effect to play, APP_LED_EFFECT_NONE to clear the layer.
+ */
+void app_led_play(app_led_layer_t layer, app_led_effect_t effect);
+
+/** Echo a light level
+ *
+ * Plays APP_LED_EFFECT_LEVEL on the feedback layer at a brightness that follows the level.
+ * Safe to call from any task.
+ *
+ * @param[in] level Light level, 0 to 254.
+ */
+void app_led_show_level(uint8_t level);
+
+#else
+
+static inline esp_err_t app_led_init()
+{
+    return ESP_OK;
+}
+static inline void app_led_play(app_led_layer_t layer, app_led_effect_t effect) {}
+static inline void app_led_show_level(uint8_t level) {}
+
+#endif // CONFIG_DIMMER_SWITCH_LED
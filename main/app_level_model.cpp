@@ -0,0 +1,267 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+
+#include <atomic>
+#include <esp_log.h>
+
+#include <app-common/zap-generated/cluster-objects.h>
+#include <app/InteractionModelEngine.h>
+#include <controller/ReadInteraction.h>
+
+#include <app_level_model.h>
+
+using namespace chip;
+using namespace chip::app::Clusters;
+
+static const char *TAG = "app_level_model";
+
+static constexpr size_t kMaxLights = CONFIG_ESP_MATTER_BINDING_TABLE_SIZE;
+static constexpr size_t kMaxSwitches = 8;
+
+typedef struct {
+    ScopedNodeId peer;
+    bool in_use = false;
+    // Set while the subscriptions are requested or up, cleared when either of them fails.
+    bool subscribed = false;
+    bool on_known = false;
+    bool level_known = false;
+    bool on = false;
+    uint8_t level = 0;
+    // Bit n set when the light is bound to the switch endpoint in snapshot slot n.
+    uint8_t switch_mask = 0;
+    // Position of the light's first binding in the last walk of the binding table.
+    uint8_t bind_order = 0;
+    // Bumped on every subscribe so reports and errors from torn down subscriptions are ignored.
+    uint32_t generation = 0;
+} light_entry_t;
+
+static light_entry_t s_lights[kMaxLights];
+static uint8_t s_bind_count = 0;
+
+// One snapshot per local switch endpoint, written in the Matter thread after every report and
+// read by the button callbacks: bit 16 set when valid, bit 8 on, bits 0-7 level. Slot
+// endpoints are stored as endpoint + 1 so that zero marks a free slot.
+static std::atomic<uint32_t> s_slot_endpoints[kMaxSwitches];
+static std::atomic<uint32_t> s_snapshots[kMaxSwitches];
+static constexpr uint32_t kSnapshotValid = 1U << 16;
+static constexpr uint32_t kSnapshotOn = 1U << 8;
+
+static int app_level_model_slot(EndpointId local_endpoint, bool add)
+{
+    for (size_t i = 0; i < kMaxSwitches; i++) {
+        uint32_t stored = s_slot_endpoints[i].load(std::memory_order_acquire);
+        if (stored == static_cast<uint32_t>(local_endpoint) + 1) {
+            return i;
+        }
+        if (stored == 0) {
+            if (!add) {
+                return -1;
+            }
+            s_slot_endpoints[i].store(static_cast<uint32_t>(local_endpoint) + 1, std::memory_order_release);
+            return i;
+        }
+    }
+    return -1;
+}
+
+static light_entry_t *app_level_model_find_peer(const ScopedNodeId &peer, bool add)
+{
+    light_entry_t *free_entry = nullptr;
+    for (light_entry_t &entry : s_lights) {
+        if (entry.in_use && entry.peer == peer) {
+            return &entry;
+        }
+        if (!entry.in_use && free_entry == nullptr) {
+            free_entry = &entry;
+        }
+    }
+    if (!add || free_entry == nullptr) {
+        return nullptr;
+    }
+    free_entry->peer = peer;
+    free_entry->in_use = true;
+    free_entry->subscribed = false;
+    free_entry->on_known = false;
+    free_entry->level_known = false;
+    free_entry->switch_mask = 0;
+    return free_entry;
+}
+
+static light_entry_t *app_level_model_find(const ScopedNodeId &peer, uint32_t generation)
+{
+    for (light_entry_t &entry : s_lights) {
+        if (entry.in_use && entry.peer == peer && entry.generation == generation) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+static void app_level_model_publish()
+{
+    for (size_t slot = 0; slot < kMaxSwitches; slot++) {
+        if (s_slot_endpoints[slot].load(std::memory_order_relaxed) == 0) {
+            break;
+        }
+
+        // Averaging lights at different levels would give a level none of them is at, so the
+        // switch follows its lead light.
+        const light_entry_t *lead = nullptr;
+        for (const light_entry_t &entry : s_lights) {
+            if (!entry.in_use || !entry.on_known || !(entry.switch_mask & (1U << slot))) {
+                continue;
+            }
+            if (lead == nullptr || entry.bind_order < lead->bind_order) {
+                lead = &entry;
+            }
+        }
+
+        uint32_t snapshot = 0;
+        if (lead != nullptr) {
+            snapshot = kSnapshotValid;
+            if (lead->on) {
+                // A light without a level reading is treated as fully on.
+                snapshot |= kSnapshotOn | (lead->level_known ? lead->level : 254);
+            }
+        }
+        s_snapshots[slot].store(snapshot, std::memory_order_relaxed);
+    }
+}
+
+void app_level_model_begin_bindings()
+{
+    for (light_entry_t &entry : s_lights) {
+        entry.switch_mask = 0;
+    }
+    s_bind_count = 0;
+}
+
+void app_level_model_bind(const ScopedNodeId &peer, EndpointId local_endpoint)
+{
+    int slot = app_level_model_slot(local_endpoint, true);
+    light_entry_t *entry = app_level_model_find_peer(peer, true);
+    if (slot < 0 || entry == nullptr) {
+        ESP_LOGW(TAG, "No room to track 0x%llx on endpoint %u", peer.GetNodeId(), local_endpoint);
+        return;
+    }
+    if (entry->switch_mask == 0) {
+        entry->bind_order = s_bind_count < UINT8_MAX ? s_bind_count++ : UINT8_MAX;
+    }
+    entry->switch_mask |= 1U << slot;
+}
+
+void app_level_model_end_bindings()
+{
+    app_level_model_publish();
+}
+
+static void app_level_model_error(const ScopedNodeId &peer, uint32_t generation, CHIP_ERROR error)
+{
+    light_entry_t *entry = app_level_model_find(peer, generation);
+    if (entry == nullptr) {
+        return;
+    }
+    ESP_LOGW(TAG, "Subscription to 0x%llx lost: %" CHIP_ERROR_FORMAT, peer.GetNodeId(), error.Format());
+    // The next peer cache refresh subscribes again.
+    entry->subscribed = false;
+    entry->on_known = false;
+    entry->level_known = false;
+    app_level_model_publish();
+}
+
+void app_level_model_subscribe(const ScopedNodeId &peer, EndpointId endpoint, Messaging::ExchangeManager &exchange_mgr,
+                               const SessionHandle &session_handle)
+{
+    // Lights are added by app_level_model_bind() during the peer cache's binding walk.
+    light_entry_t *entry = app_level_model_find_peer(peer, false);
+    if (entry == nullptr || entry->subscribed) {
+        return;
+    }
+
+    // Tear down whatever is left of an earlier subscription before replacing it.
+    app::InteractionModelEngine::GetInstance()->ShutdownSubscriptions(peer.GetFabricIndex(), peer.GetNodeId());
+
+    entry->subscribed = true;
+    entry->on_known = false;
+    entry->level_known = false;
+    uint32_t generation = ++entry->generation;
+
+    auto on_error = [peer, generation](const app::ConcreteDataAttributePath *path, CHIP_ERROR error) {
+        app_level_model_error(peer, generation, error);
+    };
+    auto on_off_report = [peer, generation](const app::ConcreteDataAttributePath &path, const bool &on) {
+        light_entry_t *entry = app_level_model_find(peer, generation);
+        if (entry == nullptr) {
+            return;
+        }
+        entry->on = on;
+        entry->on_known = true;
+        app_level_model_publish();
+    };
+    auto level_report = [peer, generation](const app::ConcreteDataAttributePath &path,
+                                           const app::DataModel::Nullable<uint8_t> &level) {
+        light_entry_t *entry = app_level_model_find(peer, generation);
+        if (entry == nullptr) {
+            return;
+        }
+        entry->level_known = !level.IsNull();
+        entry->level = level.IsNull() ? 0 : level.Value();
+        app_level_model_publish();
+    };
+
+    // Report changes as soon as they happen; the ceiling only bounds how long a silent light
+    // goes unnoticed. The first subscription asks the light to drop any stale ones from us.
+    CHIP_ERROR err = Controller::SubscribeAttribute<OnOff::Attributes::OnOff::TypeInfo>(
+                         &exchange_mgr, session_handle, endpoint, on_off_report, on_error, 0,
+                         CONFIG_DIMMER_SWITCH_LEVEL_REPORT_MAX_INTERVAL, nullptr, nullptr, true, false);
+    if (err == CHIP_NO_ERROR) {
+        err = Controller::SubscribeAttribute<LevelControl::Attributes::CurrentLevel::TypeInfo>(
+                  &exchange_mgr, session_handle, endpoint, level_report, on_error, 0,
+                  CONFIG_DIMMER_SWITCH_LEVEL_REPORT_MAX_INTERVAL, nullptr, nullptr, true, true);
+    }
+    if (err != CHIP_NO_ERROR) {
+        ESP_LOGW(TAG, "Failed to subscribe to 0x%llx: %" CHIP_ERROR_FORMAT, peer.GetNodeId(), err.Format());
+        entry->subscribed = false;
+    }
+}
+
+void app_level_model_remove(const ScopedNodeId &peer)
+{
+    for (light_entry_t &entry : s_lights) {
+        if (entry.in_use && entry.peer == peer) {
+            app::InteractionModelEngine::GetInstance()->ShutdownSubscriptions(peer.GetFabricIndex(),
+                                                                             peer.GetNodeId());
+            entry.in_use = false;
+            entry.subscribed = false;
+            entry.generation++;
+            app_level_model_publish();
+            return;
+        }
+    }
+}
+
+bool app_level_model_get(EndpointId local_endpoint, app_level_model_state_t *state)
+{
+    int slot = app_level_model_slot(local_endpoint, false);
+    if (slot < 0) {
+        return false;
+    }
+    uint32_t snapshot = s_snapshots[slot].load(std::memory_order_relaxed);
+    if (!(snapshot & kSnapshotValid)) {
+        return false;
+    }
+    state->on = snapshot & kSnapshotOn;
+    state->level = static_cast<uint8_t>(snapshot & 0xFF);
+    return true;
+}
+
+#endif // CONFIG_DIMMER_SWITCH_LEVEL_MODEL
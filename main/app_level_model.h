@@ -0,0 +1,85 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <lib/core/DataModelTypes.h>
+#include <lib/core/ScopedNodeId.h>
+#include <messaging/ExchangeMgr.h>
+#include <transport/Session.h>
+
+/* Local model of the bound lights.
+ *
+ * The switch subscribes to OnOff and CurrentLevel on every light it has a unicast binding
+ * to and keeps the last reported values. Each local switch endpoint is represented by its
+ * lead light: the first light in the binding table bound to it that has reported its state.
+ * Dimming uses the lead light to send absolute levels and to pick the hold direction, so a
+ * hold over lights at different levels starts from the lead light's level and its first
+ * MoveToLevel brings the others to it. */
+
+typedef struct {
+    /* CurrentLevel of the lead light, 0 when it is off */
+    uint8_t level;
+    /* The lead light is on */
+    bool on;
+} app_level_model_state_t;
+
+/** Start a walk of the binding table
+ *
+ * Forgets which switch endpoints each light is bound to. Follow with app_level_model_bind()
+ * for every unicast binding, in binding table order, and finish with
+ * app_level_model_end_bindings(). Must be called in the Matter thread.
+ */
+void app_level_model_begin_bindings();
+
+/** Record a unicast binding from a switch endpoint to a light
+ *
+ * @param[in] peer Bound light.
+ * @param[in] local_endpoint Switch endpoint the binding belongs to.
+ */
+void app_level_model_bind(const chip::ScopedNodeId &peer, chip::EndpointId local_endpoint);
+
+/** Finish a walk of the binding table and publish the per switch state */
+void app_level_model_end_bindings();
+
+/** Subscribe to a light's OnOff and CurrentLevel
+ *
+ * Does nothing if a subscription to the peer is already up, or if the peer was not recorded
+ * with app_level_model_bind(). Called by the peer cache once a session to the peer is
+ * established. Must be called in the Matter thread.
+ *
+ * @param[in] peer Bound light.
+ * @param[in] endpoint Remote endpoint of the binding.
+ * @param[in] exchange_mgr Exchange manager of the session.
+ * @param[in] session_handle Established CASE session to the peer.
+ */
+void app_level_model_subscribe(const chip::ScopedNodeId &peer, chip::EndpointId endpoint,
+                               chip::Messaging::ExchangeManager &exchange_mgr,
+                               const chip::SessionHandle &session_handle);
+
+/** Drop a light that is no longer bound
+ *
+ * Shuts down its subscriptions and removes it from the model. Must be called in the Matter
+ * thread.
+ *
+ * @param[in] peer Light to forget.
+ */
+void app_level_model_remove(const chip::ScopedNodeId &peer);
+
+/** Read the model for a switch endpoint
+ *
+ * Safe to call from any task.
+ *
+ * @param[in] local_endpoint Switch endpoint.
+ * @param[out] state State of the lead light bound to it.
+ *
+ * @return true if at least one of the lights bound to it has reported its state.
+ */
+bool app_level_model_get(chip::EndpointId local_endpoint, app_level_model_state_t *state);
@@ -0,0 +1,121 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_DEFERRED_LOG
+
+#include <atomic>
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <app_log.h>
+
+static const char *TAG = "app_log";
+
+static constexpr uint32_t kRingSize = CONFIG_DIMMER_SWITCH_DEFERRED_LOG_RING_SIZE;
+static_assert((kRingSize & (kRingSize - 1)) == 0, "Log ring size must be a power of two");
+
+// Bounded multi-producer queue: a cell is free for position p when its sequence is p, and
+// holds a record for the consumer when its sequence is p + 1. Sequences are stored relative
+// to the cell index so the zero-initialized ring is ready before app_log_init() runs.
+typedef struct {
+    std::atomic<uint32_t> sequence;
+    app_log_record_t record;
+} log_cell_t;
+
+static log_cell_t s_cells[kRingSize];
+static std::atomic<uint32_t> s_enqueue{0};
+// Only touched by the drain task.
+static uint32_t s_dequeue = 0;
+static std::atomic<uint32_t> s_dropped{0};
+static TaskHandle_t s_drain_task = nullptr;
+
+static inline uint32_t app_log_load_sequence(uint32_t position)
+{
+    uint32_t index = position & (kRingSize - 1);
+    return s_cells[index].sequence.load(std::memory_order_acquire) + index;
+}
+
+static inline void app_log_store_sequence(uint32_t position, uint32_t sequence)
+{
+    uint32_t index = position & (kRingSize - 1);
+    s_cells[index].sequence.store(sequence - index, std::memory_order_release);
+}
+
+app_log_record_t *app_log_reserve(uint32_t *position)
+{
+    uint32_t pos = s_enqueue.load(std::memory_order_relaxed);
+    while (true) {
+        int32_t diff = static_cast<int32_t>(app_log_load_sequence(pos) - pos);
+        if (diff == 0) {
+            if (s_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                *position = pos;
+                return &s_cells[pos & (kRingSize - 1)].record;
+            }
+        } else if (diff < 0) {
+            // The drain task hasn't caught up; drop rather than block the caller.
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            pos = s_enqueue.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void app_log_commit(uint32_t position)
+{
+    app_log_store_sequence(position, position + 1);
+    if (s_drain_task) {
+        xTaskNotifyGive(s_drain_task);
+    }
+}
+
+static void app_log_drain_task(void *arg)
+{
+    uint32_t reported_dropped = 0;
+    while (true) {
+        if (app_log_load_sequence(s_dequeue) != s_dequeue + 1) {
+            // Reported once the ring has drained, so the gap shows up after the records that made it.
+            uint32_t dropped = app_log_get_dropped();
+            if (dropped != reported_dropped) {
+                ESP_LOGW(TAG, "%lu log records dropped, ring full", dropped - reported_dropped);
+                reported_dropped = dropped;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        const app_log_record_t &record = s_cells[s_dequeue & (kRingSize - 1)].record;
+        record.print(record.level, record.tag, record.format, record.timestamp, record.args);
+
+        app_log_store_sequence(s_dequeue, s_dequeue + kRingSize);
+        s_dequeue++;
+    }
+}
+
+esp_err_t app_log_init()
+{
+    if (s_drain_task) {
+        return ESP_OK;
+    }
+    if (xTaskCreate(app_log_drain_task, "app_log", CONFIG_DIMMER_SWITCH_DEFERRED_LOG_TASK_STACK, nullptr,
+                    tskIDLE_PRIORITY + 1, &s_drain_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+uint32_t app_log_get_dropped()
+{
+    return s_dropped.load(std::memory_order_relaxed);
+}
+
+#endif // CONFIG_DIMMER_SWITCH_DEFERRED_LOG
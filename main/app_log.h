@@ -0,0 +1,146 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <sdkconfig.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Deferred logging.
+ *
+ * APP_LOGx take the same arguments as ESP_LOGx, but only copy the format pointer, the tag
+ * and the raw argument values into a lock-free ring. A low priority task formats them and
+ * writes them out, so log sites on the button and Matter paths don't wait on the UART.
+ *
+ * Arguments are copied by value. A `%s` argument must point at storage that outlives the
+ * call, such as a string literal or the result of esp_err_to_name(). */
+
+#if CONFIG_DIMMER_SWITCH_DEFERRED_LOG
+
+#include <string.h>
+#include <tuple>
+#include <utility>
+
+static constexpr size_t kAppLogMaxArgBytes = 16;
+
+typedef void (*app_log_print_t)(esp_log_level_t level, const char *tag, const char *format, uint32_t timestamp,
+                                const uint8_t *args);
+
+typedef struct {
+    app_log_print_t print;
+    const char *format;
+    const char *tag;
+    uint32_t timestamp;
+    esp_log_level_t level;
+    uint8_t args[kAppLogMaxArgBytes];
+} app_log_record_t;
+
+/** Start the drain task
+ *
+ * Records posted before this are kept and written once the task runs.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_log_init();
+
+/** Number of records dropped because the ring was full */
+uint32_t app_log_get_dropped();
+
+/* Used by app_log_post(); reserve a record, fill it in, then commit it. */
+app_log_record_t *app_log_reserve(uint32_t *position);
+void app_log_commit(uint32_t position);
+
+template <typename... Args>
+struct app_log_codec {
+    static constexpr size_t kSize = (sizeof(Args) + ... + 0);
+
+    static void pack(uint8_t *buffer, const Args &...args)
+    {
+        size_t offset = 0;
+        ((memcpy(buffer + offset, &args, sizeof(Args)), offset += sizeof(Args)), ...);
+        (void)offset;
+    }
+
+    template <size_t... I>
+    static void unpack_and_print(esp_log_level_t level, const char *tag, const char *format, uint32_t timestamp,
+                                 const uint8_t *buffer, std::index_sequence<I...>)
+    {
+        std::tuple<Args...> args;
+        size_t offset = 0;
+        ((memcpy(&std::get<I>(args), buffer + offset, sizeof(Args)), offset += sizeof(Args)), ...);
+        (void)offset;
+        esp_log_write(level, tag, format, timestamp, tag, std::get<I>(args)...);
+    }
+
+    static void print(esp_log_level_t level, const char *tag, const char *format, uint32_t timestamp,
+                      const uint8_t *buffer)
+    {
+        unpack_and_print(level, tag, format, timestamp, buffer, std::index_sequence_for<Args...>());
+    }
+};
+
+template <typename... Args>
+inline void app_log_post(esp_log_level_t level, const char *tag, const char *format, Args... args)
+{
+    static_assert(app_log_codec<Args...>::kSize <= kAppLogMaxArgBytes, "Too many log arguments to defer");
+
+    uint32_t position;
+    app_log_record_t *record = app_log_reserve(&position);
+    if (record == nullptr) {
+        return;
+    }
+    record->print = app_log_codec<Args...>::print;
+    record->format = format;
+    record->tag = tag;
+    record->timestamp = esp_log_timestamp();
+    record->level = level;
+    app_log_codec<Args...>::pack(record->args, args...);
+    app_log_commit(position);
+}
+
+/* Never called; lets the compiler check the format against the arguments. */
+static inline void app_log_check_format(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static inline void app_log_check_format(const char *format, ...) {}
+
+#define APP_LOG_DEFERRED(level, letter, tag, format, ...)                                        \
+    do {                                                                                         \
+        if (LOG_LOCAL_LEVEL >= level) {                                                          \
+            if (false) {                                                                         \
+                app_log_check_format(format, ##__VA_ARGS__);                                     \
+            }                                                                                    \
+            app_log_post(level, tag, LOG_FORMAT(letter, format), ##__VA_ARGS__);                 \
+        }                                                                                        \
+    } while (0)
+
+#define APP_LOGE(tag, format, ...) APP_LOG_DEFERRED(ESP_LOG_ERROR, E, tag, format, ##__VA_ARGS__)
+#define APP_LOGW(tag, format, ...) APP_LOG_DEFERRED(ESP_LOG_WARN, W, tag, format, ##__VA_ARGS__)
+#define APP_LOGI(tag, format, ...) APP_LOG_DEFERRED(ESP_LOG_INFO, I, tag, format, ##__VA_ARGS__)
+#define APP_LOGD(tag, format, ...) APP_LOG_DEFERRED(ESP_LOG_DEBUG, D, tag, format, ##__VA_ARGS__)
+
+#else
+
+static inline esp_err_t app_log_init()
+{
+    return ESP_OK;
+}
+
+static inline uint32_t app_log_get_dropped()
+{
+    return 0;
+}
+
+#define APP_LOGE ESP_LOGE
+#define APP_LOGW ESP_LOGW
+#define APP_LOGI ESP_LOGI
+#define APP_LOGD ESP_LOGD
+
+#endif // CONFIG_DIMMER_SWITCH_DEFERRED_LOG
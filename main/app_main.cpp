@@ -8,6 +8,9 @@
 
 #include <esp_err.h>
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs.h>
 #include <nvs_flash.h>
 
 #include <esp_matter.h>
@@ -16,8 +19,20 @@
 #include <esp_matter_providers.h>
 
 #include <common_macros.h>
+#include <app_boot.h>
+#include <app_dispatch.h>
+#include <app_led.h>
+#include <app_log.h>
+#include <app_peer_cache.h>
+#include <app_power.h>
+#include <app_ram.h>
 #include <app_priv.h>
 #include <app_reset.h>
+#include <app_touch.h>
+#include <app_trace.h>
+
+#include <app/server/Server.h>
+#include <lib/support/DefaultStorageKeyAllocator.h>
 
 #if CHIP_DEVICE_CONFIG_ENABLE_THREAD
 #include <platform/ESP32/OpenthreadLauncher.h>
@@ -27,7 +42,6 @@
 #endif
 
 static const char *TAG = "app_main";
-uint16_t switch_endpoint_id = 0;
 
 using namespace esp_matter;
 using namespace esp_matter::attribute;
@@ -37,35 +51,219 @@ using namespace esp_matter::endpoint;
 dynamic_commissionable_data_provider g_dynamic_passcode_provider;
 #endif
 
+#if CONFIG_ENABLE_OTA_REQUESTOR
+// Start of the current download, only touched in the Matter thread.
+static int64_t s_ota_download_start = 0;
+
+static void app_ota_state_changed(chip::DeviceLayer::OtaState state)
+{
+    using chip::DeviceLayer::OtaState;
+
+    switch (state) {
+    case OtaState::kOtaDownloadInProgress:
+        if (s_ota_download_start == 0) {
+            s_ota_download_start = esp_timer_get_time();
+            APP_LOGI(TAG, "OTA download started");
+        }
+        break;
+    case OtaState::kOtaDownloadComplete:
+        // With delta OTA the patch is applied as it streams in, so this covers patching too.
+        APP_LOGI(TAG, "OTA download complete in %lld ms, min free heap %lu",
+                 (esp_timer_get_time() - s_ota_download_start) / 1000, esp_get_minimum_free_heap_size());
+        s_ota_download_start = 0;
+        break;
+    case OtaState::kOtaDownloadFailed:
+    case OtaState::kOtaDownloadAborted:
+        APP_LOGW(TAG, "OTA download stopped after %lld ms", (esp_timer_get_time() - s_ota_download_start) / 1000);
+        s_ota_download_start = 0;
+        break;
+    case OtaState::kOtaApplyFailed:
+        APP_LOGW(TAG, "OTA apply failed");
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+// Startup progress, only touched in the Matter thread.
+static bool s_server_ready = false;
+static bool s_dnssd_ready = false;
+static bool s_fabric_ready = false;
+
+// Neither is needed to send the first command, so with fast start they wait for the fabric.
+static void app_start_verifier_precompute()
+{
+#if CONFIG_DYNAMIC_PASSCODE_PROVIDER_PRECOMPUTE_VERIFIER
+    static bool s_precompute_started = false;
+    if (s_precompute_started) {
+        return;
+    }
+    s_precompute_started = true;
+    if (g_dynamic_passcode_provider.StartVerifierPrecompute() != CHIP_NO_ERROR) {
+        APP_LOGW(TAG, "Failed to start Spake2p verifier precompute");
+    }
+#endif
+}
+
+#if CONFIG_DIMMER_SWITCH_FAST_START
+// The fabric table is only loaded by esp_matter::start(), so look for the fabric index the
+// stack keeps in its key value store instead.
+static bool app_has_stored_fabric()
+{
+    nvs_handle_t handle;
+    if (nvs_open_from_partition(CHIP_DEVICE_CONFIG_CHIP_KVS_NAMESPACE_PARTITION, "CHIP_KVS", NVS_READONLY,
+                                &handle) != ESP_OK) {
+        return false;
+    }
+    size_t size = 0;
+    esp_err_t err = nvs_get_blob(handle, chip::DefaultStorageKeyAllocator::FabricIndexInfo().KeyName(), nullptr,
+                                 &size);
+    nvs_close(handle);
+    return err == ESP_OK;
+}
+#endif
+
+// Effects played before this are dropped.
+static void app_start_led()
+{
+    static bool s_led_started = false;
+    if (s_led_started) {
+        return;
+    }
+    s_led_started = true;
+    if (app_led_init() != ESP_OK) {
+        APP_LOGW(TAG, "Failed to initialize the feedback LED");
+    }
+}
+
+static void app_start_console()
+{
+#if CONFIG_ENABLE_CHIP_SHELL
+    esp_matter::console::diagnostics_register_commands();
+    app_trace_register_commands();
+    app_peer_cache_register_commands();
+    app_boot_register_commands();
+    app_driver_register_commands();
+    app_ram_register_commands();
+#if CONFIG_DIMMER_SWITCH_INPUT_TOUCH
+    app_touch_register_commands();
+#endif
+    esp_matter::console::init();
+#endif
+}
+
+#if CONFIG_DIMMER_SWITCH_FAST_START
+static bool s_deferred_started = false;
+
+// Sends the presses held since boot and starts the work fast start put off.
+static void app_start_deferred()
+{
+    if (s_deferred_started) {
+        return;
+    }
+    s_deferred_started = true;
+    app_dispatch_hold(APP_DISPATCH_HOLD_STARTUP, false);
+    app_start_verifier_precompute();
+    app_start_led();
+    app_start_console();
+}
+
+// Operational discovery may never come up, e.g. when the network is gone, and the console and
+// the buffered presses must not wait on it forever.
+static void app_fast_start_timeout_cb(chip::System::Layer *layer, void *context)
+{
+    if (!s_deferred_started) {
+        APP_LOGW(TAG, "Fabric not ready after %d s, starting anyway", CONFIG_DIMMER_SWITCH_FAST_START_TIMEOUT);
+        app_start_deferred();
+    }
+}
+#endif
+
+// The fabric is up once the server runs and, when commissioned, operational discovery can
+// find the peers. Until then presses are held back in fast start mode.
+static void app_check_fabric_ready()
+{
+    if (s_fabric_ready || !s_server_ready) {
+        return;
+    }
+    if (!s_dnssd_ready && chip::Server::GetInstance().GetFabricTable().FabricCount() > 0) {
+        return;
+    }
+    s_fabric_ready = true;
+    app_boot_mark(APP_BOOT_FABRIC_READY);
+
+#if CONFIG_DIMMER_SWITCH_FAST_START
+    app_start_deferred();
+#endif
+}
+
 static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
 {
     switch (event->Type) {
     case chip::DeviceLayer::DeviceEventType::kInterfaceIpAddressChanged:
-        ESP_LOGI(TAG, "Interface IP Address Changed");
+        APP_LOGI(TAG, "Interface IP Address Changed");
         break;
 
     case chip::DeviceLayer::DeviceEventType::kCommissioningComplete:
-        ESP_LOGI(TAG, "Commissioning complete");
+        APP_LOGI(TAG, "Commissioning complete");
+        app_peer_cache_refresh();
+        app_led_play(APP_LED_LAYER_FEEDBACK, APP_LED_EFFECT_OKAY);
+        // Commissioning ran over the operational network, so it is usable now.
+        s_dnssd_ready = true;
+        app_check_fabric_ready();
         break;
 
     case chip::DeviceLayer::DeviceEventType::kFailSafeTimerExpired:
-        ESP_LOGI(TAG, "Commissioning failed, fail safe timer expired");
+        APP_LOGI(TAG, "Commissioning failed, fail safe timer expired");
         break;
 
     case chip::DeviceLayer::DeviceEventType::kCommissioningSessionStarted:
-        ESP_LOGI(TAG, "Commissioning session started");
+        APP_LOGI(TAG, "Commissioning session started");
         break;
 
     case chip::DeviceLayer::DeviceEventType::kCommissioningSessionStopped:
-        ESP_LOGI(TAG, "Commissioning session stopped");
+        APP_LOGI(TAG, "Commissioning session stopped");
         break;
 
     case chip::DeviceLayer::DeviceEventType::kCommissioningWindowOpened:
-        ESP_LOGI(TAG, "Commissioning window opened");
+        APP_LOGI(TAG, "Commissioning window opened");
+        app_led_play(APP_LED_LAYER_STATE, APP_LED_EFFECT_COMMISSIONING);
         break;
 
     case chip::DeviceLayer::DeviceEventType::kCommissioningWindowClosed:
-        ESP_LOGI(TAG, "Commissioning window closed");
+        APP_LOGI(TAG, "Commissioning window closed");
+        app_led_play(APP_LED_LAYER_STATE, APP_LED_EFFECT_NONE);
+        break;
+
+    case chip::DeviceLayer::DeviceEventType::kServerReady:
+        app_boot_mark(APP_BOOT_SERVER_READY);
+        s_server_ready = true;
+#if CONFIG_DIMMER_SWITCH_FAST_START
+        chip::DeviceLayer::SystemLayer().StartTimer(
+            chip::System::Clock::Seconds32(CONFIG_DIMMER_SWITCH_FAST_START_TIMEOUT), app_fast_start_timeout_cb,
+            nullptr);
+#endif
+        app_peer_cache_refresh();
+        app_check_fabric_ready();
+        break;
+
+    case chip::DeviceLayer::DeviceEventType::kDnssdInitialized:
+        s_dnssd_ready = true;
+        app_peer_cache_refresh();
+        app_check_fabric_ready();
+        break;
+
+#if CONFIG_ENABLE_OTA_REQUESTOR
+    case chip::DeviceLayer::DeviceEventType::kOtaStateChanged:
+        app_ota_state_changed(event->OtaStateChanged.newState);
+        break;
+#endif
+
+    case chip::DeviceLayer::DeviceEventType::kBindingsChangedViaCluster:
+        APP_LOGI(TAG, "Bindings changed");
+        app_peer_cache_requery_groups();
+        app_peer_cache_refresh();
         break;
 
     default:
@@ -78,10 +276,75 @@ static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
 static esp_err_t app_identification_cb(identification::callback_type_t type, uint16_t endpoint_id, uint8_t effect_id,
                                        uint8_t effect_variant, void *priv_data)
 {
-    ESP_LOGI(TAG, "Identification callback: type: %u, effect: %u, variant: %u", type, effect_id, effect_variant);
+    APP_LOGI(TAG, "Identification callback: type: %u, effect: %u, variant: %u", type, effect_id, effect_variant);
+
+    using chip::app::Clusters::Identify::EffectIdentifierEnum;
+
+    switch (type) {
+    case identification::callback_type_t::START:
+        app_led_play(APP_LED_LAYER_IDENTIFY, APP_LED_EFFECT_IDENTIFY);
+        break;
+    case identification::callback_type_t::STOP:
+        app_led_play(APP_LED_LAYER_IDENTIFY, APP_LED_EFFECT_NONE);
+        break;
+    case identification::callback_type_t::EFFECT:
+        switch (static_cast<EffectIdentifierEnum>(effect_id)) {
+        case EffectIdentifierEnum::kBlink:
+            app_led_play(APP_LED_LAYER_IDENTIFY, APP_LED_EFFECT_BLINK);
+            break;
+        case EffectIdentifierEnum::kBreathe:
+            app_led_play(APP_LED_LAYER_IDENTIFY, APP_LED_EFFECT_BREATHE);
+            break;
+        case EffectIdentifierEnum::kOkay:
+            app_led_play(APP_LED_LAYER_IDENTIFY, APP_LED_EFFECT_OKAY);
+            break;
+        case EffectIdentifierEnum::kChannelChange:
+            app_led_play(APP_LED_LAYER_IDENTIFY, APP_LED_EFFECT_CHANNEL_CHANGE);
+            break;
+        default:
+            // Finish and stop both end the effect; the effects are short enough to cut.
+            app_led_play(APP_LED_LAYER_IDENTIFY, APP_LED_EFFECT_NONE);
+            break;
+        }
+        break;
+    default:
+        break;
+    }
     return ESP_OK;
 }
 
+// Off, night, 50% and full.
+static uint8_t s_default_presets[] = {
+    APP_PRESET_LEVEL, 0, APP_PRESET_LEVEL, 38, APP_PRESET_LEVEL, 127, APP_PRESET_LEVEL, 254,
+};
+
+// Adds the vendor presets cluster to a switch endpoint and loads the stored presets, or the
+// defaults on first boot, into the driver.
+static esp_err_t app_presets_create(endpoint_t *endpoint)
+{
+    cluster_t *cluster = cluster::create(endpoint, APP_PRESETS_CLUSTER_ID, CLUSTER_FLAG_SERVER);
+    if (!cluster) {
+        return ESP_FAIL;
+    }
+    cluster::global::attribute::create_cluster_revision(cluster, 1);
+    cluster::global::attribute::create_feature_map(cluster, 0);
+
+    attribute_t *attribute = attribute::create(cluster, APP_PRESETS_ATTRIBUTE_ID,
+                                               ATTRIBUTE_FLAG_NONVOLATILE | ATTRIBUTE_FLAG_WRITABLE,
+                                               esp_matter_octet_str(s_default_presets, sizeof(s_default_presets)),
+                                               2 * APP_PRESETS_MAX);
+    if (!attribute) {
+        return ESP_FAIL;
+    }
+
+    esp_matter_attr_val_t val = esp_matter_invalid(NULL);
+    esp_err_t err = attribute::get_val(attribute, &val);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return app_driver_switch_set_presets(endpoint::get_id(endpoint), val.val.a.b, val.val.a.s);
+}
+
 // This callback is called for every attribute update. The callback implementation shall
 // handle the desired attributes and return an appropriate error code. If the attribute
 // is not of your interest, please do not return an error code and strictly return ESP_OK.
@@ -90,6 +353,10 @@ static esp_err_t app_attribute_update_cb(callback_type_t type, uint16_t endpoint
 {
     if (type == PRE_UPDATE) {
         /* Handle the attribute updates here. */
+        if (cluster_id == APP_PRESETS_CLUSTER_ID && attribute_id == APP_PRESETS_ATTRIBUTE_ID) {
+            // Malformed presets are rejected before they are stored.
+            return app_driver_switch_set_presets(endpoint_id, val->val.a.b, val->val.a.s);
+        }
     }
 
     return ESP_OK;
@@ -99,28 +366,59 @@ extern "C" void app_main()
 {
     esp_err_t err = ESP_OK;
 
+    app_boot_mark(APP_BOOT_APP_MAIN);
+
+    /* Start the deferred logger first so early log lines don't fill its ring */
+    err = app_log_init();
+    ABORT_APP_ON_FAILURE(err == ESP_OK, ESP_LOGE(TAG, "Failed to start deferred logger, err:%d", err));
+
     /* Initialize the ESP NVS layer */
     nvs_flash_init();
+    if (app_boot_init() != ESP_OK) {
+        APP_LOGW(TAG, "Failed to load the previous boot report");
+    }
+    app_boot_mark(APP_BOOT_NVS);
+
+    err = app_power_init();
+    ABORT_APP_ON_FAILURE(err == ESP_OK, ESP_LOGE(TAG, "Failed to initialize power management, err:%d", err));
 
-    /* Initialize driver */
-    app_driver_handle_t switch_handle = app_driver_switch_init();
-    //app_reset_button_register(switch_handle);
+#if CONFIG_DIMMER_SWITCH_FAST_START
+    /* Buffer presses until the fabric is up, they are sent as soon as it is */
+    app_dispatch_hold(APP_DISPATCH_HOLD_STARTUP, true);
+#else
+    app_start_led();
+#endif
 
     /* Create a Matter node and add the mandatory Root Node device type on endpoint 0 */
     node::config_t node_config;
     node_t *node = node::create(&node_config, app_attribute_update_cb, app_identification_cb);
     ABORT_APP_ON_FAILURE(node != nullptr, ESP_LOGE(TAG, "Failed to create Matter node"));
+    app_boot_mark(APP_BOOT_NODE);
+
+    /* Initialize the driver and create a dimmer switch endpoint for every switch */
+    for (uint8_t i = 0; i < app_driver_switch_count(); i++) {
+        app_driver_handle_t switch_handle = app_driver_switch_init(i);
+        //app_reset_button_register(switch_handle);
 
-    dimmer_switch::config_t switch_config;
-    endpoint_t *endpoint = dimmer_switch::create(node, &switch_config, ENDPOINT_FLAG_NONE, switch_handle);
-    ABORT_APP_ON_FAILURE(endpoint != nullptr, ESP_LOGE(TAG, "Failed to create on off switch endpoint"));
+        dimmer_switch::config_t switch_config;
+        endpoint_t *endpoint = dimmer_switch::create(node, &switch_config, ENDPOINT_FLAG_NONE, switch_handle);
+        ABORT_APP_ON_FAILURE(endpoint != nullptr, ESP_LOGE(TAG, "Failed to create on off switch endpoint"));
 
-    /* Add group cluster to the switch endpoint */
-    cluster::groups::config_t groups_config;
-    cluster::groups::create(endpoint, &groups_config, CLUSTER_FLAG_SERVER | CLUSTER_FLAG_CLIENT);
+        /* Add group cluster to the switch endpoint */
+        cluster::groups::config_t groups_config;
+        cluster::groups::create(endpoint, &groups_config, CLUSTER_FLAG_SERVER | CLUSTER_FLAG_CLIENT);
 
-    switch_endpoint_id = endpoint::get_id(endpoint);
-    ESP_LOGI(TAG, "Switch created with endpoint_id %d", switch_endpoint_id);
+        uint16_t endpoint_id = endpoint::get_id(endpoint);
+        app_driver_switch_set_endpoint(i, endpoint_id);
+
+        /* Presets are looked up by endpoint, so the endpoint must be set first */
+        err = app_presets_create(endpoint);
+        if (err != ESP_OK) {
+            APP_LOGW(TAG, "Failed to add presets to endpoint %d, err:%d", endpoint_id, err);
+        }
+        APP_LOGI(TAG, "Switch %u created with endpoint_id %d", i, endpoint_id);
+    }
+    app_boot_mark(APP_BOOT_SWITCHES);
 
 #if CHIP_DEVICE_CONFIG_ENABLE_THREAD
     /* Set OpenThread platform config */
@@ -136,8 +434,23 @@ extern "C" void app_main()
     /* This should be called before esp_matter::start() */
     esp_matter::set_custom_commissionable_data_provider(&g_dynamic_passcode_provider);
 #endif
+#if CONFIG_DIMMER_SWITCH_FAST_START
+    /* An uncommissioned switch has no command to send and needs the verifier and the LED to commission */
+    if (!app_has_stored_fabric()) {
+        app_start_verifier_precompute();
+        app_start_led();
+    }
+#else
+    app_start_verifier_precompute();
+#endif
+    app_boot_mark(APP_BOOT_PLATFORM);
 
     /* Matter start */
     err = esp_matter::start(app_event_cb);
     ABORT_APP_ON_FAILURE(err == ESP_OK, ESP_LOGE(TAG, "Failed to start Matter, err:%d", err));
+    app_boot_mark(APP_BOOT_MATTER_START);
+
+#if !CONFIG_DIMMER_SWITCH_FAST_START
+    app_start_console();
+#endif
 }
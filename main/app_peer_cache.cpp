@@ -0,0 +1,337 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_matter_console.h>
+#include <esp_timer.h>
+
+#include <app-common/zap-generated/cluster-objects.h>
+#include <app/server/Server.h>
+#include <app/util/binding-table.h>
+#include <controller/InvokeInteraction.h>
+#include <transport/SessionHolder.h>
+
+#include <app_level_model.h>
+#include <app_peer_cache.h>
+
+using namespace chip;
+using namespace chip::app::Clusters;
+
+static const char *TAG = "app_peer_cache";
+
+static constexpr size_t kMaxPeers = CONFIG_ESP_MATTER_BINDING_TABLE_SIZE;
+static constexpr size_t kMaxGroupsPerPeer = 4;
+
+static void app_peer_cache_connected_cb(void *context, Messaging::ExchangeManager &exchange_mgr,
+                                        const SessionHandle &session_handle);
+static void app_peer_cache_failure_cb(void *context, const ScopedNodeId &peer, CHIP_ERROR error);
+
+typedef struct peer_entry {
+    peer_entry()
+        : on_connected(app_peer_cache_connected_cb, this)
+        , on_failure(app_peer_cache_failure_cb, this) {}
+
+    ScopedNodeId peer;
+    // Remote endpoint of the first binding to the peer, used to query its group membership.
+    EndpointId endpoint = kInvalidEndpointId;
+    bool in_use = false;
+    bool connecting = false;
+    bool groups_known = false;
+    // The membership is still used, but is asked again on the next refresh.
+    bool groups_stale = false;
+    bool groups_pending = false;
+    uint8_t group_count = 0;
+    GroupId groups[kMaxGroupsPerPeer];
+    // Valid while the session is up. The session manager clears it if the session is evicted.
+    SessionHolder session;
+    int64_t connect_start_time = 0;
+    Callback::Callback<OnDeviceConnected> on_connected;
+    Callback::Callback<OnDeviceConnectionFailure> on_failure;
+} peer_entry_t;
+
+static peer_entry_t s_peers[kMaxPeers];
+static app_peer_cache_stats_t s_stats;
+static bool s_timer_armed = false;
+
+static peer_entry_t *app_peer_cache_find(const ScopedNodeId &peer)
+{
+    for (peer_entry_t &entry : s_peers) {
+        if (entry.in_use && entry.peer == peer) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// Asks the peer which groups it is in, so commands can be collapsed into a groupcast when
+// every peer that would receive them is a member of a bound group.
+static void app_peer_cache_query_groups(peer_entry_t *entry, Messaging::ExchangeManager &exchange_mgr,
+                                        const SessionHandle &session_handle)
+{
+    if ((entry->groups_known && !entry->groups_stale) || entry->groups_pending) {
+        return;
+    }
+
+    ScopedNodeId peer = entry->peer;
+    auto on_success = [peer](const app::ConcreteCommandPath &command_path, const app::StatusIB &status,
+                             const Groups::Commands::GetGroupMembershipResponse::DecodableType &response) {
+        peer_entry_t *entry = app_peer_cache_find(peer);
+        if (entry == nullptr) {
+            return;
+        }
+        entry->groups_pending = false;
+        entry->groups_known = true;
+        entry->groups_stale = false;
+        entry->group_count = 0;
+        auto iter = response.groupList.begin();
+        while (iter.Next() && entry->group_count < kMaxGroupsPerPeer) {
+            entry->groups[entry->group_count++] = iter.GetValue();
+        }
+    };
+    auto on_failure = [peer](CHIP_ERROR error) {
+        peer_entry_t *entry = app_peer_cache_find(peer);
+        if (entry != nullptr) {
+            entry->groups_pending = false;
+        }
+    };
+
+    // An empty group list asks for every group the endpoint belongs to.
+    Groups::Commands::GetGroupMembership::Type command;
+    if (Controller::InvokeCommandRequest(&exchange_mgr, session_handle, entry->endpoint, command, on_success,
+                                         on_failure) == CHIP_NO_ERROR) {
+        entry->groups_pending = true;
+    }
+}
+
+static void app_peer_cache_connected_cb(void *context, Messaging::ExchangeManager &exchange_mgr,
+                                        const SessionHandle &session_handle)
+{
+    peer_entry_t *entry = static_cast<peer_entry_t *>(context);
+    entry->connecting = false;
+    entry->session.Grab(session_handle);
+
+    uint32_t establish_ms = static_cast<uint32_t>((esp_timer_get_time() - entry->connect_start_time) / 1000);
+    s_stats.established++;
+    s_stats.last_establish_ms = establish_ms;
+    s_stats.total_establish_ms += establish_ms;
+    if (establish_ms > s_stats.max_establish_ms) {
+        s_stats.max_establish_ms = establish_ms;
+    }
+    ESP_LOGI(TAG, "Session to 0x%llx ready in %lu ms", entry->peer.GetNodeId(), establish_ms);
+
+    // The light may have rebooted or been reconfigured while the session was down. The last
+    // answer stands until the new one replaces it, so the light doesn't get both a unicast and
+    // the groupcast meanwhile.
+    entry->groups_stale = true;
+    app_peer_cache_query_groups(entry, exchange_mgr, session_handle);
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+    app_level_model_subscribe(entry->peer, entry->endpoint, exchange_mgr, session_handle);
+#endif
+}
+
+static void app_peer_cache_failure_cb(void *context, const ScopedNodeId &peer, CHIP_ERROR error)
+{
+    peer_entry_t *entry = static_cast<peer_entry_t *>(context);
+    entry->connecting = false;
+    s_stats.failures++;
+    ESP_LOGW(TAG, "Failed to establish session to 0x%llx: %" CHIP_ERROR_FORMAT, peer.GetNodeId(), error.Format());
+}
+
+static void app_peer_cache_connect(peer_entry_t *entry)
+{
+    if (entry->connecting || entry->session) {
+        return;
+    }
+
+    CASESessionManager *case_session_mgr = Server::GetInstance().GetCASESessionManager();
+    if (case_session_mgr == nullptr) {
+        return;
+    }
+
+    entry->connecting = true;
+    entry->connect_start_time = esp_timer_get_time();
+    // Completes synchronously if a session to the peer already exists.
+    case_session_mgr->FindOrEstablishSession(entry->peer, &entry->on_connected, &entry->on_failure);
+}
+
+static void app_peer_cache_release(peer_entry_t *entry)
+{
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+    app_level_model_remove(entry->peer);
+#endif
+    entry->on_connected.Cancel();
+    entry->on_failure.Cancel();
+    entry->session.Release();
+    entry->connecting = false;
+    entry->groups_known = false;
+    entry->groups_stale = false;
+    entry->groups_pending = false;
+    entry->in_use = false;
+}
+
+void app_peer_cache_requery_groups()
+{
+    for (peer_entry_t &entry : s_peers) {
+        entry.groups_stale = true;
+    }
+}
+
+static void app_peer_cache_timer_cb(System::Layer *layer, void *context)
+{
+    s_timer_armed = false;
+    // Group membership can change without the switch hearing of it, so it is asked again on
+    // every periodic refresh.
+    app_peer_cache_requery_groups();
+    app_peer_cache_refresh();
+}
+
+void app_peer_cache_refresh()
+{
+    bool bound[kMaxPeers] = {};
+
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+    app_level_model_begin_bindings();
+#endif
+    for (const EmberBindingTableEntry &binding : BindingTable::GetInstance()) {
+        if (binding.type != MATTER_UNICAST_BINDING) {
+            continue;
+        }
+
+        ScopedNodeId peer(binding.nodeId, binding.fabricIndex);
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+        app_level_model_bind(peer, binding.local);
+#endif
+        peer_entry_t *entry = app_peer_cache_find(peer);
+        if (entry == nullptr) {
+            for (peer_entry_t &free_entry : s_peers) {
+                if (!free_entry.in_use) {
+                    entry = &free_entry;
+                    entry->peer = peer;
+                    entry->endpoint = binding.remote;
+                    entry->in_use = true;
+                    break;
+                }
+            }
+        }
+        if (entry == nullptr) {
+            ESP_LOGW(TAG, "No room to cache session to 0x%llx", binding.nodeId);
+            continue;
+        }
+
+        bound[entry - s_peers] = true;
+        if (entry->session) {
+            if (!entry->groups_known || entry->groups_stale) {
+                app_peer_cache_query_groups(entry, Server::GetInstance().GetExchangeManager(),
+                                            entry->session.Get().Value());
+            }
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+            // Resubscribes if the light dropped the subscription since the last refresh.
+            app_level_model_subscribe(entry->peer, entry->endpoint, Server::GetInstance().GetExchangeManager(),
+                                      entry->session.Get().Value());
+#endif
+        }
+        app_peer_cache_connect(entry);
+    }
+
+#if CONFIG_DIMMER_SWITCH_LEVEL_MODEL
+    app_level_model_end_bindings();
+#endif
+
+    for (size_t i = 0; i < kMaxPeers; i++) {
+        if (s_peers[i].in_use && !bound[i]) {
+            app_peer_cache_release(&s_peers[i]);
+        }
+    }
+
+    if (!s_timer_armed) {
+        s_timer_armed = DeviceLayer::SystemLayer().StartTimer(
+                            System::Clock::Seconds32(CONFIG_DIMMER_SWITCH_SESSION_REFRESH_INTERVAL),
+                            app_peer_cache_timer_cb, nullptr) == CHIP_NO_ERROR;
+    }
+}
+
+void app_peer_cache_record_send(const ScopedNodeId &peer)
+{
+    peer_entry_t *entry = app_peer_cache_find(peer);
+    if (entry != nullptr && entry->session) {
+        s_stats.hits++;
+        return;
+    }
+
+    s_stats.misses++;
+    if (entry != nullptr) {
+        // The client just established a session on demand; pick it up.
+        app_peer_cache_connect(entry);
+    }
+}
+
+bool app_peer_cache_covered_by_group(const ScopedNodeId &peer, EndpointId local_endpoint, ClusterId cluster_id)
+{
+    peer_entry_t *entry = app_peer_cache_find(peer);
+    if (entry == nullptr || !entry->groups_known) {
+        return false;
+    }
+
+    for (const EmberBindingTableEntry &binding : BindingTable::GetInstance()) {
+        if (binding.type != MATTER_MULTICAST_BINDING || binding.local != local_endpoint ||
+            binding.fabricIndex != peer.GetFabricIndex() ||
+            (binding.clusterId.HasValue() && binding.clusterId.Value() != cluster_id)) {
+            continue;
+        }
+        for (uint8_t i = 0; i < entry->group_count; i++) {
+            if (entry->groups[i] == binding.groupId) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void app_peer_cache_get_stats(app_peer_cache_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+static esp_err_t app_peer_cache_console_handler(int argc, char **argv)
+{
+    if (argc == 0 || strcmp(argv[0], "stats") == 0) {
+        app_peer_cache_stats_t stats;
+        app_peer_cache_get_stats(&stats);
+        printf("hits=%lu misses=%lu established=%lu failures=%lu\n", stats.hits, stats.misses, stats.established,
+               stats.failures);
+        printf("establish last=%lu max=%lu avg=%lu ms\n", stats.last_establish_ms, stats.max_establish_ms,
+               stats.established ? stats.total_establish_ms / stats.established : 0);
+        for (const peer_entry_t &entry : s_peers) {
+            if (!entry.in_use) {
+                continue;
+            }
+            printf("%u:0x%llx session=%s groups=%d\n", entry.peer.GetFabricIndex(), entry.peer.GetNodeId(),
+                   entry.session ? "up" : (entry.connecting ? "connecting" : "down"),
+                   entry.groups_known ? entry.group_count : -1);
+        }
+    } else if (strcmp(argv[0], "reset") == 0) {
+        memset(&s_stats, 0, sizeof(s_stats));
+    } else {
+        ESP_LOGE(TAG, "Usage: peers [stats|reset]");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_peer_cache_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "peers",
+        .description = "Peer session cache. Usage: matter esp peers [stats|reset]",
+        .handler = app_peer_cache_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
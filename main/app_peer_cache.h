@@ -0,0 +1,82 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#include <lib/core/DataModelTypes.h>
+#include <lib/core/ScopedNodeId.h>
+
+typedef struct {
+    /* Commands sent to a peer whose session was already warm */
+    uint32_t hits;
+    /* Commands that had to wait for a session to be established */
+    uint32_t misses;
+    /* Sessions established by the cache */
+    uint32_t established;
+    /* Failed establishment attempts */
+    uint32_t failures;
+    uint32_t last_establish_ms;
+    uint32_t max_establish_ms;
+    uint32_t total_establish_ms;
+} app_peer_cache_stats_t;
+
+/** Establish sessions to every peer in the binding table
+ *
+ * Walks the unicast bindings, starts CASE establishment to peers without a session and
+ * forgets peers that are no longer bound. Also arms a periodic timer that repeats the walk,
+ * re-establishing sessions the peers have dropped. Must be called in the Matter thread.
+ */
+void app_peer_cache_refresh();
+
+/** Record that a command is being sent to a peer
+ *
+ * Counts a hit if the cache had a session to the peer ready, a miss otherwise. Must be
+ * called in the Matter thread, before the send can be skipped.
+ *
+ * @param[in] peer Peer the command is sent to.
+ */
+void app_peer_cache_record_send(const chip::ScopedNodeId &peer);
+
+/** Check whether a peer also receives commands through a group binding
+ *
+ * True when the peer reported membership of a group that is bound to the local endpoint
+ * for the cluster. Membership is queried with Groups GetGroupMembership each time a session
+ * to the peer comes up and again on every periodic refresh. The last answer is used until
+ * the next one replaces it; before the first answer this returns false.
+ *
+ * @param[in] peer Peer bound to the local endpoint.
+ * @param[in] local_endpoint Switch endpoint the command is sent from.
+ * @param[in] cluster_id Cluster of the command.
+ *
+ * @return true if a groupcast already reaches the peer.
+ */
+bool app_peer_cache_covered_by_group(const chip::ScopedNodeId &peer, chip::EndpointId local_endpoint,
+                                     chip::ClusterId cluster_id);
+
+/** Ask every peer for its group membership again
+ *
+ * Membership is queried again on the next refresh, and the last known membership is used
+ * until the answer arrives. Must be called in the Matter thread.
+ */
+void app_peer_cache_requery_groups();
+
+/** Read the cache counters
+ *
+ * @param[out] stats Counters since boot.
+ */
+void app_peer_cache_get_stats(app_peer_cache_stats_t *stats);
+
+/** Register the `peers` console command
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_peer_cache_register_commands();
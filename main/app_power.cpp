@@ -0,0 +1,99 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_POWER_SCHEDULER
+
+#include <atomic>
+
+#include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_timer.h>
+
+#include <platform/CHIPDeviceLayer.h>
+#if CHIP_CONFIG_ENABLE_ICD_SERVER
+#include <app/icd/server/ICDNotifier.h>
+#endif
+
+#include <app_power.h>
+
+static const char *TAG = "app_power";
+
+static constexpr uint64_t kActiveWindowUs = CONFIG_DIMMER_SWITCH_ACTIVE_WINDOW_MS * 1000ULL;
+
+static esp_pm_lock_handle_t s_active_lock = nullptr;
+static esp_timer_handle_t s_window_timer = nullptr;
+static std::atomic<bool> s_active{false};
+static int64_t s_active_since = 0;
+static app_power_stats_t s_stats;
+
+static void app_power_window_cb(void *arg)
+{
+    // Runs in the esp_timer task, like app_power_wake() from the button callbacks, so the
+    // window can't be reopened while it is being closed.
+    s_stats.active_ms += static_cast<uint32_t>((esp_timer_get_time() - s_active_since) / 1000);
+    s_active.store(false, std::memory_order_release);
+    esp_pm_lock_release(s_active_lock);
+}
+
+esp_err_t app_power_init()
+{
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure power management, err:%d", err);
+        return err;
+    }
+
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "active", &s_active_lock);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = app_power_window_cb;
+    timer_args.name = "active_window";
+    return esp_timer_create(&timer_args, &s_window_timer);
+}
+
+void app_power_wake()
+{
+    if (!s_active_lock) {
+        return;
+    }
+
+    if (!s_active.exchange(true, std::memory_order_acq_rel)) {
+        esp_pm_lock_acquire(s_active_lock);
+        s_active_since = esp_timer_get_time();
+        s_stats.wakes++;
+    }
+    // Restarting a timer that isn't running fails, so it is stopped first.
+    esp_timer_stop(s_window_timer);
+    esp_timer_start_once(s_window_timer, kActiveWindowUs);
+}
+
+void app_power_notify_activity()
+{
+#if CHIP_CONFIG_ENABLE_ICD_SERVER
+    chip::app::ICDNotifier::GetInstance().NotifyNetworkActivityNotification();
+#endif
+}
+
+void app_power_get_stats(app_power_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+#endif // CONFIG_DIMMER_SWITCH_POWER_SCHEDULER
@@ -0,0 +1,75 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+#include <stdint.h>
+
+/* Power state scheduler.
+ *
+ * While idle the switch lets the chip light sleep between ticks, and as an ICD the radio
+ * polls its parent at the slow poll interval. A press opens an active window: the CPU is held
+ * at full speed and the ICD manager is told about the activity, so it switches to fast
+ * polling and acks and follow-up Steps aren't held up by the sleep schedule. Each press
+ * extends the window, and the switch goes back to sleep once it closes. */
+
+typedef struct {
+    /* Idle to active transitions */
+    uint32_t wakes;
+    /* Time spent in active windows, in milliseconds */
+    uint32_t active_ms;
+} app_power_stats_t;
+
+#if CONFIG_DIMMER_SWITCH_POWER_SCHEDULER
+
+/** Configure power management
+ *
+ * Enables dynamic frequency scaling and automatic light sleep.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_power_init();
+
+/** Open or extend the active window
+ *
+ * Call on the raw press, before the gesture is recognized, so the CPU is at full speed by
+ * the time the command is built. Must be called from the esp_timer task, where the button
+ * and slider callbacks run.
+ */
+void app_power_wake();
+
+/** Report activity to the ICD manager
+ *
+ * Keeps the ICD in active mode, polling fast, for its active mode threshold. Must be called
+ * in the Matter thread.
+ */
+void app_power_notify_activity();
+
+/** Read the scheduler counters
+ *
+ * @param[out] stats Counters since boot.
+ */
+void app_power_get_stats(app_power_stats_t *stats);
+
+#else
+
+static inline esp_err_t app_power_init()
+{
+    return ESP_OK;
+}
+static inline void app_power_wake() {}
+static inline void app_power_notify_activity() {}
+static inline void app_power_get_stats(app_power_stats_t *stats)
+{
+    *stats = {};
+}
+
+#endif // CONFIG_DIMMER_SWITCH_POWER_SCHEDULER
@@ -17,14 +17,76 @@
 
 typedef void *app_driver_handle_t;
 
-/** Initialize the switch driver
+/* Vendor cluster on every switch endpoint holding its presets */
+#define APP_PRESETS_CLUSTER_ID 0xFFF1FC20
+/* Octet string, two bytes per preset: the kind (APP_PRESET_LEVEL or APP_PRESET_SCENE), then
+ * the level or the scene ID */
+#define APP_PRESETS_ATTRIBUTE_ID 0x0000
+#define APP_PRESETS_MAX 4
+#define APP_PRESET_LEVEL 0
+#define APP_PRESET_SCENE 1
+
+/** Number of switches
+ *
+ * One per button in the button table, or one for the touch pad or slider.
+ *
+ * @return Number of switches, each of which gets its own dimmer switch endpoint.
+ */
+uint8_t app_driver_switch_count();
+
+/** Check whether a GPIO is taken by a button
+ *
+ * @param[in] gpio_num GPIO to look up.
+ *
+ * @return true if a button in the button table is wired to it.
+ */
+bool app_driver_gpio_in_use(int gpio_num);
+
+/** Initialize a switch
+ *
+ * This initializes the switch driver associated with the selected board. Switch 0 must be
+ * initialized first, it also sets up the command dispatch shared by all switches.
+ *
+ * @param[in] index Switch index, less than app_driver_switch_count().
+ *
+ * @return Button handle on success.
+ * @return NULL in case of failure, or when there is no button component behind the switch
+ *         (touch slider, interrupt driven buttons).
+ */
+app_driver_handle_t app_driver_switch_init(uint8_t index);
+
+/** Set the endpoint of a switch
+ *
+ * Commands from the switch are sent to the bindings of this endpoint.
+ *
+ * @param[in] index Switch index, less than app_driver_switch_count().
+ * @param[in] endpoint_id Dimmer switch endpoint created for the switch.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_driver_switch_set_endpoint(uint8_t index, uint16_t endpoint_id);
+
+/** Set the presets of a switch
+ *
+ * @param[in] endpoint_id Switch endpoint.
+ * @param[in] data Presets in the APP_PRESETS_ATTRIBUTE_ID format.
+ * @param[in] size Size of data, at most 2 * APP_PRESETS_MAX bytes.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_ARG if the presets are malformed or the endpoint isn't a switch.
+ */
+esp_err_t app_driver_switch_set_presets(uint16_t endpoint_id, const uint8_t *data, uint16_t size);
+
+/** Register the driver console commands
  *
- * This initializes the switch driver associated with the selected board.
+ * Adds `load`, which drives synthetic hold traffic from a switch for load testing, when it
+ * is enabled.
  *
- * @return Handle on success.
- * @return NULL in case of failure.
+ * @return ESP_OK on success.
+ * @return error in case of failure.
  */
-app_driver_handle_t app_driver_switch_init();
+esp_err_t app_driver_register_commands();
 
 #if CHIP_DEVICE_CONFIG_ENABLE_THREAD
 #define ESP_OPENTHREAD_DEFAULT_RADIO_CONFIG()                                           \
@@ -0,0 +1,156 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_RAM_ACCOUNTING
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_matter_console.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <app_ram.h>
+
+static const char *TAG = "app_ram";
+
+static constexpr const char *kScopeNames[APP_RAM_SCOPE_MAX] = {"press", "send"};
+
+#if !CONFIG_FREERTOS_USE_TRACE_FACILITY
+// Without the trace facility tasks can't be listed, so the ones that matter are looked up by name.
+static constexpr const char *kTaskNames[] = {"CHIP", "esp_timer", "app_log", "ot_task", "IDLE"};
+#endif
+
+typedef struct {
+    // Task the scope is active in, and how deeply it is nested there.
+    std::atomic<TaskHandle_t> task;
+    uint8_t depth;
+    std::atomic<uint32_t> allocs;
+    std::atomic<uint32_t> bytes;
+} ram_scope_t;
+
+static ram_scope_t s_scopes[APP_RAM_SCOPE_MAX];
+// Allocations outside every scope.
+static std::atomic<uint32_t> s_other_allocs{0};
+static std::atomic<uint32_t> s_frees{0};
+
+void app_ram_scope_enter(app_ram_scope_t scope)
+{
+    ram_scope_t *entry = &s_scopes[scope];
+    if (entry->depth++ == 0) {
+        entry->task.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+    }
+}
+
+void app_ram_scope_exit(app_ram_scope_t scope)
+{
+    ram_scope_t *entry = &s_scopes[scope];
+    if (entry->depth > 0 && --entry->depth == 0) {
+        entry->task.store(nullptr, std::memory_order_release);
+    }
+}
+
+// Called by the heap for every allocation, possibly with the cache disabled, so it stays in IRAM
+// and only touches counters.
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < APP_RAM_SCOPE_MAX; i++) {
+        if (s_scopes[i].task.load(std::memory_order_acquire) == task) {
+            s_scopes[i].allocs.fetch_add(1, std::memory_order_relaxed);
+            s_scopes[i].bytes.fetch_add(size, std::memory_order_relaxed);
+#if CONFIG_DIMMER_SWITCH_RAM_STRICT_PRESS_PATH
+            if (i == APP_RAM_SCOPE_PRESS) {
+                abort();
+            }
+#endif
+            return;
+        }
+    }
+    s_other_allocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+    s_frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void app_ram_print_task(const char *name, UBaseType_t high_water_mark)
+{
+    printf("%-16s stack min free=%lu\n", name, static_cast<unsigned long>(high_water_mark));
+}
+
+static void app_ram_print_tasks()
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    static TaskStatus_t s_tasks[32];
+    UBaseType_t count = uxTaskGetSystemState(s_tasks, sizeof(s_tasks) / sizeof(s_tasks[0]), nullptr);
+    for (UBaseType_t i = 0; i < count; i++) {
+        app_ram_print_task(s_tasks[i].pcTaskName, s_tasks[i].usStackHighWaterMark);
+    }
+#else
+    for (const char *name : kTaskNames) {
+        TaskHandle_t task = xTaskGetHandle(name);
+        if (task) {
+            app_ram_print_task(name, uxTaskGetStackHighWaterMark(task));
+        }
+    }
+#endif
+}
+
+static void app_ram_print_stats()
+{
+    printf("heap free=%u min_free=%u largest_block=%u\n", heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+           heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT), heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    printf("internal free=%u min_free=%u\n", heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+           heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    for (size_t i = 0; i < APP_RAM_SCOPE_MAX; i++) {
+        printf("%-16s allocs=%lu bytes=%lu\n", kScopeNames[i], s_scopes[i].allocs.load(std::memory_order_relaxed),
+               s_scopes[i].bytes.load(std::memory_order_relaxed));
+    }
+    printf("%-16s allocs=%lu frees=%lu\n", "other", s_other_allocs.load(std::memory_order_relaxed),
+           s_frees.load(std::memory_order_relaxed));
+    app_ram_print_tasks();
+}
+
+static esp_err_t app_ram_console_handler(int argc, char **argv)
+{
+    if (argc == 0 || strcmp(argv[0], "stats") == 0) {
+        app_ram_print_stats();
+    } else if (strcmp(argv[0], "reset") == 0) {
+        for (size_t i = 0; i < APP_RAM_SCOPE_MAX; i++) {
+            s_scopes[i].allocs.store(0, std::memory_order_relaxed);
+            s_scopes[i].bytes.store(0, std::memory_order_relaxed);
+        }
+        s_other_allocs.store(0, std::memory_order_relaxed);
+        s_frees.store(0, std::memory_order_relaxed);
+    } else {
+        ESP_LOGE(TAG, "Usage: ram [stats|reset]");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_ram_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "ram",
+        .description = "Heap, stack and allocation counts. Usage: matter esp ram [stats|reset]",
+        .handler = app_ram_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
+
+#endif // CONFIG_DIMMER_SWITCH_RAM_ACCOUNTING
@@ -0,0 +1,62 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+#include <stdint.h>
+
+/* RAM accounting.
+ *
+ * Heap allocation hooks count allocations and bytes per scope: the press path, from the raw
+ * button edge to the intent landing in the dispatch ring, and the send path, from the intent
+ * being drained in the Matter thread to the commands being handed to the stack. The press path
+ * is meant to never allocate, and can be made to abort if it does. The `ram` console command
+ * also shows heap minimums and the stack high water marks of the tasks. */
+
+typedef enum : uint8_t {
+    APP_RAM_SCOPE_PRESS = 0,
+    APP_RAM_SCOPE_SEND,
+    APP_RAM_SCOPE_MAX,
+} app_ram_scope_t;
+
+#if CONFIG_DIMMER_SWITCH_RAM_ACCOUNTING
+
+/** Enter a scope in the calling task
+ *
+ * Allocations made by the calling task until the matching app_ram_scope_exit() are counted
+ * against the scope. Scopes nest, and a scope is only active in one task at a time.
+ *
+ * @param[in] scope Scope entered.
+ */
+void app_ram_scope_enter(app_ram_scope_t scope);
+
+/** Leave a scope
+ *
+ * @param[in] scope Scope left.
+ */
+void app_ram_scope_exit(app_ram_scope_t scope);
+
+/** Register the `ram` console command
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_ram_register_commands();
+
+#else
+
+static inline void app_ram_scope_enter(app_ram_scope_t scope) {}
+static inline void app_ram_scope_exit(app_ram_scope_t scope) {}
+static inline esp_err_t app_ram_register_commands()
+{
+    return ESP_OK;
+}
+
+#endif // CONFIG_DIMMER_SWITCH_RAM_ACCOUNTING
@@ -0,0 +1,293 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_INPUT_TOUCH
+
+#include <stdio.h>
+#include <string.h>
+
+#include <driver/touch_pad.h>
+#include <esp_log.h>
+#include <esp_matter_console.h>
+#include <esp_timer.h>
+
+#include <app_touch.h>
+
+static const char *TAG = "app_touch";
+
+static constexpr int kFracBits = 4;
+// Low-pass of the readings: each sample moves the output by 1/4 of the difference.
+static constexpr int kFilterShift = 2;
+// Baseline drift tracking: 1/64 of the difference per untouched sample.
+static constexpr int kBaselineShift = 6;
+// Samples used to seed the baseline before touches are reported.
+static constexpr uint8_t kWarmupSamples = 8;
+static constexpr uint8_t kDebounceSamples = 2;
+
+#if CONFIG_IDF_TARGET_ESP32
+// On the ESP32 a finger lowers the reading; on later chips it raises it.
+static constexpr int32_t kTouchSign = -1;
+#else
+static constexpr int32_t kTouchSign = 1;
+#endif
+
+static app_touch_stats_t s_stats;
+
+static uint32_t median3(uint32_t a, uint32_t b, uint32_t c)
+{
+    if (a > b) {
+        uint32_t t = a;
+        a = b;
+        b = t;
+    }
+    return c < a ? a : (c > b ? b : c);
+}
+
+// Threshold in raw units, as a per mille fraction of the baseline.
+static int32_t touch_threshold(const app_touch_filter_t *filter, uint32_t per_mille)
+{
+    return static_cast<int32_t>((static_cast<uint64_t>(filter->baseline >> kFracBits) * per_mille) / 1000);
+}
+
+int32_t app_touch_filter_update(app_touch_filter_t *filter, uint32_t raw)
+{
+    filter->median[filter->median_index] = raw;
+    filter->median_index = (filter->median_index + 1) % 3;
+
+    if (filter->sample_count < kWarmupSamples) {
+        if (filter->sample_count == 0) {
+            filter->median[1] = filter->median[2] = raw;
+            filter->filtered = filter->baseline = static_cast<int32_t>(raw) << kFracBits;
+        }
+        filter->sample_count++;
+    }
+
+    int32_t sample = static_cast<int32_t>(median3(filter->median[0], filter->median[1], filter->median[2])) << kFracBits;
+    filter->filtered += (sample - filter->filtered) >> kFilterShift;
+
+    int32_t strength = (kTouchSign * (filter->filtered - filter->baseline)) >> kFracBits;
+    if (filter->sample_count < kWarmupSamples) {
+        filter->baseline += (filter->filtered - filter->baseline) >> kFilterShift;
+        return 0;
+    }
+
+    // Hysteresis between the press and release thresholds, then debounce.
+    bool over = strength > touch_threshold(filter, filter->touched ? CONFIG_DIMMER_SWITCH_TOUCH_RELEASE_THRESHOLD
+                                                                     : CONFIG_DIMMER_SWITCH_TOUCH_PRESS_THRESHOLD);
+    if (over != filter->touched) {
+        if (++filter->debounce >= kDebounceSamples) {
+            filter->touched = over;
+            filter->debounce = 0;
+            if (over) {
+                s_stats.presses++;
+            }
+        }
+    } else {
+        if (filter->debounce > 0) {
+            s_stats.rejected++;
+        }
+        filter->debounce = 0;
+    }
+
+    // Only track drift while untouched, and follow readings that move away from a touch
+    // quickly so the baseline never sits above a released pad.
+    if (!filter->touched) {
+        int shift = strength < 0 ? kFilterShift : kBaselineShift;
+        filter->baseline += (filter->filtered - filter->baseline) >> shift;
+    }
+
+    return strength < 0 ? 0 : strength;
+}
+
+static uint32_t touch_read(touch_pad_t channel)
+{
+#if CONFIG_IDF_TARGET_ESP32
+    uint16_t value = 0;
+    touch_pad_read(channel, &value);
+#else
+    uint32_t value = 0;
+    touch_pad_read_raw_data(channel, &value);
+#endif
+    return value;
+}
+
+static esp_err_t touch_start(const touch_pad_t *channels, size_t count)
+{
+    esp_err_t err = touch_pad_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (size_t i = 0; i < count; i++) {
+#if CONFIG_IDF_TARGET_ESP32
+        err = touch_pad_config(channels[i], 0);
+#else
+        err = touch_pad_config(channels[i]);
+#endif
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    touch_pad_set_fsm_mode(TOUCH_FSM_MODE_TIMER);
+#if !CONFIG_IDF_TARGET_ESP32
+    touch_pad_fsm_start();
+#endif
+    return ESP_OK;
+}
+
+#if !CONFIG_DIMMER_SWITCH_TOUCH_SLIDER
+static app_touch_filter_t s_button_filter;
+
+static esp_err_t touch_button_init(void *param)
+{
+    const touch_pad_t channel = static_cast<touch_pad_t>(CONFIG_DIMMER_SWITCH_TOUCH_CHANNEL);
+    return touch_start(&channel, 1);
+}
+
+// Called by the button component every button tick.
+static uint8_t touch_button_get_key_value(void *param)
+{
+    app_touch_filter_update(&s_button_filter, touch_read(static_cast<touch_pad_t>(CONFIG_DIMMER_SWITCH_TOUCH_CHANNEL)));
+    return s_button_filter.touched ? 1 : 0;
+}
+
+static esp_err_t touch_button_deinit(void *param)
+{
+    return touch_pad_deinit();
+}
+
+void app_touch_button_config(button_config_t *config)
+{
+    memset(config, 0, sizeof(button_config_t));
+    config->type = BUTTON_TYPE_CUSTOM;
+    config->custom_button_config.active_level = 1;
+    config->custom_button_config.button_custom_init = touch_button_init;
+    config->custom_button_config.button_custom_get_key_value = touch_button_get_key_value;
+    config->custom_button_config.button_custom_deinit = touch_button_deinit;
+}
+#else
+static constexpr size_t kSliderChannels = CONFIG_DIMMER_SWITCH_TOUCH_SLIDER_CHANNEL_COUNT;
+static constexpr uint32_t kSliderPeriodMs = 20;
+// Finger movement smaller than this is ignored, and reports are at most this often.
+static constexpr int32_t kSliderMinLevelChange = 3;
+static constexpr int64_t kSliderMinReportIntervalUs = 100 * 1000;
+
+static app_touch_filter_t s_slider_filters[kSliderChannels];
+static app_touch_slider_cb_t s_slider_cb = nullptr;
+static esp_timer_handle_t s_slider_timer = nullptr;
+static int32_t s_last_level = -1;
+static int64_t s_last_report_time = 0;
+
+static void touch_slider_timer_cb(void *arg)
+{
+    int32_t strength[kSliderChannels];
+    int32_t total = 0;
+    bool touched = false;
+    for (size_t i = 0; i < kSliderChannels; i++) {
+        touch_pad_t channel = static_cast<touch_pad_t>(CONFIG_DIMMER_SWITCH_TOUCH_SLIDER_FIRST_CHANNEL + i);
+        strength[i] = app_touch_filter_update(&s_slider_filters[i], touch_read(channel));
+        total += strength[i];
+        touched |= s_slider_filters[i].touched;
+    }
+
+    if (!touched || total == 0) {
+        s_last_level = -1;
+        return;
+    }
+
+    // Centroid of the pad strengths, with the pads spread evenly over 0-254.
+    int32_t weighted = 0;
+    for (size_t i = 0; i < kSliderChannels; i++) {
+        weighted += strength[i] * static_cast<int32_t>(i * 254 / (kSliderChannels - 1));
+    }
+    int32_t level = weighted / total;
+
+    int64_t now = esp_timer_get_time();
+    int32_t change = s_last_level < 0 ? 255 : (level > s_last_level ? level - s_last_level : s_last_level - level);
+    if (change < kSliderMinLevelChange || now - s_last_report_time < kSliderMinReportIntervalUs) {
+        return;
+    }
+    s_last_level = level;
+    s_last_report_time = now;
+    s_slider_cb(static_cast<uint8_t>(level));
+}
+
+esp_err_t app_touch_slider_init(app_touch_slider_cb_t callback)
+{
+    if (!callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_slider_cb = callback;
+
+    touch_pad_t channels[kSliderChannels];
+    for (size_t i = 0; i < kSliderChannels; i++) {
+        channels[i] = static_cast<touch_pad_t>(CONFIG_DIMMER_SWITCH_TOUCH_SLIDER_FIRST_CHANNEL + i);
+    }
+    esp_err_t err = touch_start(channels, kSliderChannels);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start touch slider: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = touch_slider_timer_cb;
+    timer_args.name = "touch_slider";
+    err = esp_timer_create(&timer_args, &s_slider_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_timer_start_periodic(s_slider_timer, kSliderPeriodMs * 1000);
+}
+#endif
+
+void app_touch_get_stats(app_touch_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+static void app_touch_print_filter(unsigned channel, const app_touch_filter_t *filter)
+{
+    printf("channel %u filtered=%ld baseline=%ld %s\n", channel, filter->filtered >> kFracBits,
+           filter->baseline >> kFracBits, filter->touched ? "touched" : "released");
+}
+
+// Counters and filter state are read without synchronization, so a line may be one sample old.
+static esp_err_t app_touch_console_handler(int argc, char **argv)
+{
+    if (argc == 0 || strcmp(argv[0], "stats") == 0) {
+        app_touch_stats_t stats;
+        app_touch_get_stats(&stats);
+        printf("presses=%lu rejected=%lu\n", stats.presses, stats.rejected);
+#if !CONFIG_DIMMER_SWITCH_TOUCH_SLIDER
+        app_touch_print_filter(CONFIG_DIMMER_SWITCH_TOUCH_CHANNEL, &s_button_filter);
+#else
+        for (size_t i = 0; i < kSliderChannels; i++) {
+            app_touch_print_filter(CONFIG_DIMMER_SWITCH_TOUCH_SLIDER_FIRST_CHANNEL + i, &s_slider_filters[i]);
+        }
+#endif
+    } else if (strcmp(argv[0], "reset") == 0) {
+        memset(&s_stats, 0, sizeof(s_stats));
+    } else {
+        ESP_LOGE(TAG, "Usage: touch [stats|reset]");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_touch_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "touch",
+        .description = "Touch counters and filter state. Usage: matter esp touch [stats|reset]",
+        .handler = app_touch_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
+
+#endif // CONFIG_DIMMER_SWITCH_INPUT_TOUCH
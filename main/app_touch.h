@@ -0,0 +1,90 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#include <iot_button.h>
+
+/* Capacitive touch front end.
+ *
+ * Raw touch samples go through a 3-tap median and an integer IIR low-pass, and are compared
+ * against a baseline that slowly tracks drift (temperature, humidity, enclosure) while the
+ * pad isn't touched. Filter state is fixed-point (4 fractional bits) and statically allocated.
+ *
+ * In button mode the pad is exposed as a custom iot_button, so the regular press, long press
+ * and hold callbacks fire from it. In slider mode a row of pads is sampled on a timer and the
+ * finger position is reported as a level. */
+
+/** Fixed-point touch channel filter */
+typedef struct {
+    uint32_t median[3];
+    uint8_t median_index;
+    uint8_t sample_count;
+    /* Filtered reading and baseline, both with 4 fractional bits */
+    int32_t filtered;
+    int32_t baseline;
+    /* Consecutive samples that disagree with the debounced state */
+    uint8_t debounce;
+    bool touched;
+} app_touch_filter_t;
+
+typedef struct {
+    /* Debounced touches */
+    uint32_t presses;
+    /* Threshold crossings that didn't survive debouncing */
+    uint32_t rejected;
+} app_touch_stats_t;
+
+/** Feed a raw sample through a channel filter
+ *
+ * @param[in] filter Channel filter.
+ * @param[in] raw Raw touch reading.
+ *
+ * @return Touch strength in raw units above the baseline, never negative.
+ */
+int32_t app_touch_filter_update(app_touch_filter_t *filter, uint32_t raw);
+
+/** Fill a button config for a touch pad button
+ *
+ * The returned config uses BUTTON_TYPE_CUSTOM; its key level is the debounced touch state of
+ * CONFIG_DIMMER_SWITCH_TOUCH_CHANNEL, sampled every button tick.
+ *
+ * @param[out] config Button config to pass to iot_button_create().
+ */
+void app_touch_button_config(button_config_t *config);
+
+/** Called from the esp_timer task with the level under the finger, 0-254 */
+typedef void (*app_touch_slider_cb_t)(uint8_t level);
+
+/** Start sampling the touch slider
+ *
+ * @param[in] callback Called when the finger position changes.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_touch_slider_init(app_touch_slider_cb_t callback);
+
+/** Read the touch counters
+ *
+ * @param[out] stats Counters since boot.
+ */
+void app_touch_get_stats(app_touch_stats_t *stats);
+
+/** Register the `touch` console command
+ *
+ * Prints the touch counters and the filtered reading and baseline of every channel, for
+ * tuning the thresholds.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_touch_register_commands();
@@ -0,0 +1,271 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <sdkconfig.h>
+
+#if CONFIG_DIMMER_SWITCH_LATENCY_TRACE
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_matter_console.h>
+#include <esp_timer.h>
+
+#include <app-common/zap-generated/ids/Clusters.h>
+
+#include <app_trace.h>
+
+using namespace chip::app::Clusters;
+
+static const char *TAG = "app_trace";
+
+static constexpr uint32_t kRingSize = CONFIG_DIMMER_SWITCH_LATENCY_TRACE_RING_SIZE;
+static_assert((kRingSize & (kRingSize - 1)) == 0, "Trace ring size must be a power of two");
+
+// Start times of recent traces, indexed by the low bits of the trace ID.
+static constexpr uint32_t kStartSlots = 64;
+static constexpr size_t kMaxPeers = CONFIG_ESP_MATTER_BINDING_TABLE_SIZE;
+static constexpr uint8_t kNoPeer = 0xFF;
+// Bucket i counts latencies in [2^i, 2^(i+1)) us; the last one also takes everything above.
+static constexpr size_t kBuckets = 24;
+
+typedef enum : uint8_t {
+    TRACE_CLUSTER_ON_OFF = 0,
+    TRACE_CLUSTER_LEVEL_CONTROL,
+    TRACE_CLUSTER_OTHER,
+    TRACE_CLUSTER_MAX,
+} trace_cluster_t;
+
+typedef struct {
+    uint32_t time_us;
+    uint16_t trace_id;
+    app_trace_stage_t stage;
+    uint8_t peer;
+} trace_record_t;
+
+typedef struct {
+    uint32_t buckets[kBuckets];
+    uint32_t count;
+    uint32_t failures;
+    uint32_t max_us;
+} trace_histogram_t;
+
+typedef struct {
+    chip::ScopedNodeId node;
+    // Trace awaiting completion for each cluster, 0 when none.
+    uint16_t pending[TRACE_CLUSTER_MAX];
+    trace_histogram_t histogram;
+} trace_peer_t;
+
+static trace_record_t s_ring[kRingSize];
+// Written by both the button task and the Matter thread.
+static std::atomic<uint32_t> s_ring_next{0};
+static std::atomic<uint16_t> s_next_trace_id{0};
+static uint32_t s_start_time_us[kStartSlots];
+
+// Only touched in the Matter thread.
+static trace_peer_t s_peers[kMaxPeers];
+static uint8_t s_peer_count = 0;
+static trace_histogram_t s_clusters[TRACE_CLUSTER_MAX];
+
+static const char *const kStageNames[APP_TRACE_STAGE_MAX] = {
+    "button", "enqueue", "cluster_update", "send", "ack", "failure",
+};
+static const char *const kClusterNames[TRACE_CLUSTER_MAX] = {
+    "OnOff", "LevelControl", "other",
+};
+
+static trace_cluster_t app_trace_cluster(chip::ClusterId cluster_id)
+{
+    switch (cluster_id) {
+    case OnOff::Id:
+        return TRACE_CLUSTER_ON_OFF;
+    case LevelControl::Id:
+        return TRACE_CLUSTER_LEVEL_CONTROL;
+    default:
+        return TRACE_CLUSTER_OTHER;
+    }
+}
+
+static uint8_t app_trace_peer(const chip::ScopedNodeId &node, bool add)
+{
+    for (uint8_t i = 0; i < s_peer_count; i++) {
+        if (s_peers[i].node == node) {
+            return i;
+        }
+    }
+    if (!add || s_peer_count >= kMaxPeers) {
+        return kNoPeer;
+    }
+    s_peers[s_peer_count] = {};
+    s_peers[s_peer_count].node = node;
+    return s_peer_count++;
+}
+
+static void app_trace_store(uint16_t trace_id, app_trace_stage_t stage, uint8_t peer, uint32_t now)
+{
+    trace_record_t &record = s_ring[s_ring_next.fetch_add(1, std::memory_order_relaxed) & (kRingSize - 1)];
+    record.time_us = now;
+    record.trace_id = trace_id;
+    record.stage = stage;
+    record.peer = peer;
+}
+
+static void app_trace_histogram_add(trace_histogram_t *histogram, uint32_t latency_us, bool success)
+{
+    if (!success) {
+        histogram->failures++;
+        return;
+    }
+    size_t bucket = latency_us == 0 ? 0 : 31 - __builtin_clz(latency_us);
+    histogram->buckets[bucket < kBuckets ? bucket : kBuckets - 1]++;
+    histogram->count++;
+    if (latency_us > histogram->max_us) {
+        histogram->max_us = latency_us;
+    }
+}
+
+// Upper bound of the bucket holding the given percentile.
+static uint32_t app_trace_percentile(const trace_histogram_t *histogram, uint32_t percent)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint32_t rank = (histogram->count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint32_t upper = (i + 1 < kBuckets) ? (1U << (i + 1)) : histogram->max_us;
+            return upper < histogram->max_us ? upper : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+uint16_t app_trace_begin()
+{
+    uint16_t trace_id = s_next_trace_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (trace_id == 0) {
+        trace_id = s_next_trace_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    s_start_time_us[trace_id & (kStartSlots - 1)] = now;
+    app_trace_store(trace_id, APP_TRACE_BUTTON, kNoPeer, now);
+    return trace_id;
+}
+
+void app_trace_record(uint16_t trace_id, app_trace_stage_t stage)
+{
+    if (trace_id == 0) {
+        return;
+    }
+    app_trace_store(trace_id, stage, kNoPeer, static_cast<uint32_t>(esp_timer_get_time()));
+}
+
+void app_trace_send(uint16_t trace_id, const chip::ScopedNodeId &node, chip::ClusterId cluster_id)
+{
+    if (trace_id == 0) {
+        return;
+    }
+    uint8_t peer = app_trace_peer(node, true);
+    if (peer != kNoPeer) {
+        // A newer send to the same cluster supersedes the one still in flight.
+        s_peers[peer].pending[app_trace_cluster(cluster_id)] = trace_id;
+    }
+    app_trace_store(trace_id, APP_TRACE_SEND, peer, static_cast<uint32_t>(esp_timer_get_time()));
+}
+
+void app_trace_complete(const chip::ScopedNodeId &node, chip::ClusterId cluster_id, bool success)
+{
+    uint8_t peer = app_trace_peer(node, false);
+    if (peer == kNoPeer) {
+        return;
+    }
+    trace_cluster_t cluster = app_trace_cluster(cluster_id);
+    uint16_t trace_id = s_peers[peer].pending[cluster];
+    if (trace_id == 0) {
+        return;
+    }
+    s_peers[peer].pending[cluster] = 0;
+
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    uint32_t latency_us = now - s_start_time_us[trace_id & (kStartSlots - 1)];
+    app_trace_store(trace_id, success ? APP_TRACE_ACK : APP_TRACE_FAILURE, peer, now);
+    app_trace_histogram_add(&s_clusters[cluster], latency_us, success);
+    app_trace_histogram_add(&s_peers[peer].histogram, latency_us, success);
+}
+
+static void app_trace_print_histogram(const char *name, const trace_histogram_t *histogram)
+{
+    printf("%-20s n=%-6lu fail=%-4lu p50=%-8lu p99=%-8lu max=%lu us\n", name, histogram->count,
+           histogram->failures, app_trace_percentile(histogram, 50), app_trace_percentile(histogram, 99),
+           histogram->max_us);
+}
+
+static void app_trace_print_stats()
+{
+    for (size_t i = 0; i < TRACE_CLUSTER_MAX; i++) {
+        app_trace_print_histogram(kClusterNames[i], &s_clusters[i]);
+    }
+    for (uint8_t i = 0; i < s_peer_count; i++) {
+        char name[24];
+        snprintf(name, sizeof(name), "%u:0x%llx", s_peers[i].node.GetFabricIndex(), s_peers[i].node.GetNodeId());
+        app_trace_print_histogram(name, &s_peers[i].histogram);
+    }
+}
+
+static void app_trace_print_ring()
+{
+    uint32_t next = s_ring_next.load(std::memory_order_relaxed);
+    uint32_t first = next > kRingSize ? next - kRingSize : 0;
+    for (uint32_t i = first; i < next; i++) {
+        const trace_record_t &record = s_ring[i & (kRingSize - 1)];
+        uint32_t since_start = record.time_us - s_start_time_us[record.trace_id & (kStartSlots - 1)];
+        if (record.peer != kNoPeer) {
+            printf("%5u %-14s +%-8lu us %u:0x%llx\n", record.trace_id, kStageNames[record.stage], since_start,
+                   s_peers[record.peer].node.GetFabricIndex(), s_peers[record.peer].node.GetNodeId());
+        } else {
+            printf("%5u %-14s +%-8lu us\n", record.trace_id, kStageNames[record.stage], since_start);
+        }
+    }
+}
+
+// Counters are read without synchronization, so a line may be off by a command that
+// completed while it was printed.
+static esp_err_t app_trace_console_handler(int argc, char **argv)
+{
+    if (argc == 0 || strcmp(argv[0], "stats") == 0) {
+        app_trace_print_stats();
+    } else if (strcmp(argv[0], "dump") == 0) {
+        app_trace_print_ring();
+    } else if (strcmp(argv[0], "reset") == 0) {
+        memset(s_clusters, 0, sizeof(s_clusters));
+        for (uint8_t i = 0; i < s_peer_count; i++) {
+            memset(&s_peers[i].histogram, 0, sizeof(trace_histogram_t));
+        }
+    } else {
+        ESP_LOGE(TAG, "Usage: latency [stats|dump|reset]");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_trace_register_commands()
+{
+    static const esp_matter::console::command_t command = {
+        .name = "latency",
+        .description = "Press to ack latency. Usage: matter esp latency [stats|dump|reset]",
+        .handler = app_trace_console_handler,
+    };
+    return esp_matter::console::add_commands(&command, 1);
+}
+
+#endif // CONFIG_DIMMER_SWITCH_LATENCY_TRACE
@@ -0,0 +1,96 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#pragma once
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+#include <stdint.h>
+
+#include <lib/core/DataModelTypes.h>
+#include <lib/core/ScopedNodeId.h>
+
+/* Latency tracing.
+ *
+ * Every button intent gets a trace ID, and each stage it goes through is timestamped into a
+ * fixed ring: the button event, enqueueing for the Matter thread, cluster_update, the send to
+ * each peer and the peer's ack or failure. Press-to-ack latencies are also folded into
+ * power-of-two histograms per cluster and per peer. Nothing is allocated, and recording a
+ * stage is a handful of stores. */
+
+typedef enum : uint8_t {
+    APP_TRACE_BUTTON = 0,
+    APP_TRACE_ENQUEUE,
+    APP_TRACE_CLUSTER_UPDATE,
+    APP_TRACE_SEND,
+    APP_TRACE_ACK,
+    APP_TRACE_FAILURE,
+    APP_TRACE_STAGE_MAX,
+} app_trace_stage_t;
+
+#if CONFIG_DIMMER_SWITCH_LATENCY_TRACE
+
+/** Start tracing a button event
+ *
+ * Records APP_TRACE_BUTTON. Must be called from the button task.
+ *
+ * @return Trace ID to pass to the later stages, never 0.
+ */
+uint16_t app_trace_begin();
+
+/** Record a stage that isn't tied to a peer
+ *
+ * @param[in] trace_id ID returned by app_trace_begin(), 0 to ignore.
+ * @param[in] stage Stage reached.
+ */
+void app_trace_record(uint16_t trace_id, app_trace_stage_t stage);
+
+/** Record a unicast send
+ *
+ * Remembers the trace against the peer and cluster, so the ack can be matched to it. Must be
+ * called in the Matter thread.
+ *
+ * @param[in] trace_id ID of the intent being sent, 0 to ignore.
+ * @param[in] peer Peer the command was sent to.
+ * @param[in] cluster_id Cluster of the command.
+ */
+void app_trace_send(uint16_t trace_id, const chip::ScopedNodeId &peer, chip::ClusterId cluster_id);
+
+/** Record the outcome of a unicast send
+ *
+ * Adds the press-to-completion latency to the histograms of the cluster and the peer. Must
+ * be called in the Matter thread.
+ *
+ * @param[in] peer Peer that answered.
+ * @param[in] cluster_id Cluster of the command.
+ * @param[in] success true for an ack, false for a failure.
+ */
+void app_trace_complete(const chip::ScopedNodeId &peer, chip::ClusterId cluster_id, bool success);
+
+/** Register the `latency` console command
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t app_trace_register_commands();
+
+#else
+
+static inline uint16_t app_trace_begin()
+{
+    return 0;
+}
+static inline void app_trace_record(uint16_t trace_id, app_trace_stage_t stage) {}
+static inline void app_trace_send(uint16_t trace_id, const chip::ScopedNodeId &peer, chip::ClusterId cluster_id) {}
+static inline void app_trace_complete(const chip::ScopedNodeId &peer, chip::ClusterId cluster_id, bool success) {}
+static inline esp_err_t app_trace_register_commands()
+{
+    return ESP_OK;
+}
+
+#endif // CONFIG_DIMMER_SWITCH_LATENCY_TRACE
@@ -15,6 +15,8 @@
 #include <crypto/CHIPCryptoPAL.h>
 #include <custom_provider/dynamic_commissionable_data_provider.h>
 #include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <lib/support/Base64.h>
 #include <platform/ESP32/ESP32Config.h>
 #include <setup_payload/SetupPayload.h>
@@ -61,38 +63,114 @@ static bool is_valid_base64_str(const char *str)
     return true;
 }
 
-CHIP_ERROR dynamic_commissionable_data_provider::GetSpake2pSalt(MutableByteSpan &saltBuf)
+// Decodes and validates the configured salt once; later calls reuse it.
+CHIP_ERROR dynamic_commissionable_data_provider::LoadSaltLocked()
 {
+    if (mSaltLen != 0) {
+        return CHIP_NO_ERROR;
+    }
     const char *saltB64 = CONFIG_DYNAMIC_PASSCODE_PROVIDER_SALT_BASE64;
     ReturnErrorCodeIf(!is_valid_base64_str(saltB64), CHIP_ERROR_INVALID_ARGUMENT);
     size_t saltB64Len = strlen(saltB64);
     uint8_t salt[chip::Crypto::kSpake2p_Max_PBKDF_Salt_Length];
     size_t saltLen = chip::Base64Decode32(saltB64, saltB64Len, salt);
     ReturnErrorCodeIf(saltLen < chip::Crypto::kSpake2p_Min_PBKDF_Salt_Length, CHIP_ERROR_INVALID_ARGUMENT);
-    ReturnErrorCodeIf(saltLen > saltBuf.size(), CHIP_ERROR_BUFFER_TOO_SMALL);
+    ReturnErrorCodeIf(saltLen > chip::Crypto::kSpake2p_Max_PBKDF_Salt_Length, CHIP_ERROR_INVALID_ARGUMENT);
 
-    memcpy(saltBuf.data(), salt, saltLen);
-    saltBuf.reduce_size(saltLen);
+    memcpy(mSalt, salt, saltLen);
+    mSaltLen = saltLen;
     return CHIP_NO_ERROR;
 }
 
-CHIP_ERROR dynamic_commissionable_data_provider::GetSpake2pVerifier(MutableByteSpan &verifierBuf, size_t &verifierLen)
+CHIP_ERROR dynamic_commissionable_data_provider::GetSpake2pSalt(MutableByteSpan &saltBuf)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    ReturnErrorOnFailure(LoadSaltLocked());
+    ReturnErrorCodeIf(mSaltLen > saltBuf.size(), CHIP_ERROR_BUFFER_TOO_SMALL);
+
+    memcpy(saltBuf.data(), mSalt, mSaltLen);
+    saltBuf.reduce_size(mSaltLen);
+    return CHIP_NO_ERROR;
+}
+
+// Runs PBKDF2 for the current passcode unless the cached verifier already matches it. mLock is
+// only held to read the inputs and to publish the result, so the passcode and salt can be read
+// while PBKDF2 runs; mGenerateLock keeps a second caller from running it again meanwhile.
+CHIP_ERROR dynamic_commissionable_data_provider::GenerateVerifier()
 {
+    std::lock_guard<std::mutex> generateLock(mGenerateLock);
+
     uint32_t setupPasscode = 0;
+    uint8_t salt[chip::Crypto::kSpake2p_Max_PBKDF_Salt_Length];
+    size_t saltLen = 0;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        ReturnErrorOnFailure(GetSetupPasscodeLocked(setupPasscode));
+        if (mVerifierLen != 0 && mVerifierPasscode == setupPasscode) {
+            return CHIP_NO_ERROR;
+        }
+        ReturnErrorOnFailure(LoadSaltLocked());
+        memcpy(salt, mSalt, mSaltLen);
+        saltLen = mSaltLen;
+    }
+
     uint32_t iterationCount = 0;
-    uint8_t salt[Crypto::kSpake2p_Max_PBKDF_Salt_Length] = {0};
-    chip::MutableByteSpan saltSpan(salt, Crypto::kSpake2p_Max_PBKDF_Salt_Length);
-    ReturnErrorOnFailure(GetSetupPasscode(setupPasscode));
     ReturnErrorOnFailure(GetSpake2pIterationCount(iterationCount));
-    ReturnErrorOnFailure(GetSpake2pSalt(saltSpan));
     chip::Crypto::Spake2pVerifier verifier;
-    ReturnErrorOnFailure(verifier.Generate(iterationCount, saltSpan, setupPasscode));
-    ReturnErrorOnFailure(verifier.Serialize(verifierBuf));
-    verifierLen = verifierBuf.size();
+    ReturnErrorOnFailure(verifier.Generate(iterationCount, ByteSpan(salt, saltLen), setupPasscode));
+    uint8_t serialized[chip::Crypto::kSpake2p_VerifierSerialized_Length];
+    MutableByteSpan verifierSpan(serialized);
+    ReturnErrorOnFailure(verifier.Serialize(verifierSpan));
+
+    std::lock_guard<std::mutex> lock(mLock);
+    memcpy(mVerifier, verifierSpan.data(), verifierSpan.size());
+    mVerifierLen = verifierSpan.size();
+    mVerifierPasscode = setupPasscode;
     return CHIP_NO_ERROR;
 }
 
+CHIP_ERROR dynamic_commissionable_data_provider::GetSpake2pVerifier(MutableByteSpan &verifierBuf, size_t &verifierLen)
+{
+    ReturnErrorOnFailure(GenerateVerifier());
+
+    std::lock_guard<std::mutex> lock(mLock);
+    ReturnErrorCodeIf(mVerifierLen > verifierBuf.size(), CHIP_ERROR_BUFFER_TOO_SMALL);
+
+    memcpy(verifierBuf.data(), mVerifier, mVerifierLen);
+    verifierBuf.reduce_size(mVerifierLen);
+    verifierLen = mVerifierLen;
+    return CHIP_NO_ERROR;
+}
+
+void dynamic_commissionable_data_provider::VerifierPrecomputeTask(void *arg)
+{
+    dynamic_commissionable_data_provider *provider = static_cast<dynamic_commissionable_data_provider *>(arg);
+    CHIP_ERROR err = provider->GenerateVerifier();
+    if (err != CHIP_NO_ERROR) {
+        ESP_LOGE(TAG, "Failed to precompute Spake2p verifier: %" CHIP_ERROR_FORMAT, err.Format());
+    }
+    vTaskDelete(NULL);
+}
+
+CHIP_ERROR dynamic_commissionable_data_provider::StartVerifierPrecompute()
+{
+    // Pick the passcode before the task starts, so it is never generated while PBKDF2 runs.
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        uint32_t setupPasscode = 0;
+        ReturnErrorOnFailure(GetSetupPasscodeLocked(setupPasscode));
+    }
+    BaseType_t ret = xTaskCreate(VerifierPrecomputeTask, "spake2p_verifier", 6144, this, tskIDLE_PRIORITY + 1, NULL);
+    return ret == pdPASS ? CHIP_NO_ERROR : CHIP_ERROR_NO_MEMORY;
+}
+
 CHIP_ERROR dynamic_commissionable_data_provider::GetSetupPasscode(uint32_t &setupPasscode)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return GetSetupPasscodeLocked(setupPasscode);
+}
+
+CHIP_ERROR dynamic_commissionable_data_provider::GetSetupPasscodeLocked(uint32_t &setupPasscode)
 {
     if (mSetupPasscode == 0) {
         ReturnErrorOnFailure(GenerateRandomPasscode(mSetupPasscode));
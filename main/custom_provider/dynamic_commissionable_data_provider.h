@@ -17,6 +17,8 @@
 #include <crypto/CHIPCryptoPAL.h>
 #include <platform/CommissionableDataProvider.h>
 
+#include <mutex>
+
 using chip::MutableByteSpan;
 using chip::DeviceLayer::CommissionableDataProvider;
 
@@ -33,7 +35,25 @@ public:
     CHIP_ERROR GetSpake2pVerifier(MutableByteSpan &verifierBuf, size_t &verifierLen) override;
     CHIP_ERROR GetSetupPasscode(uint32_t &setupPasscode) override;
     CHIP_ERROR SetSetupPasscode(uint32_t setupPasscode) override { return CHIP_ERROR_NOT_IMPLEMENTED; }
+
+    // Generate the verifier for the current passcode in a low priority task, so the first
+    // commissioning window doesn't wait for PBKDF2.
+    CHIP_ERROR StartVerifierPrecompute();
 private:
     CHIP_ERROR GenerateRandomPasscode(uint32_t &passcode);
+    CHIP_ERROR GetSetupPasscodeLocked(uint32_t &setupPasscode);
+    CHIP_ERROR LoadSaltLocked();
+    CHIP_ERROR GenerateVerifier();
+    static void VerifierPrecomputeTask(void *arg);
+
+    std::mutex mLock;
+    // Held while the verifier is generated
+    std::mutex mGenerateLock;
     uint32_t mSetupPasscode = 0;
+    uint8_t mSalt[chip::Crypto::kSpake2p_Max_PBKDF_Salt_Length];
+    size_t mSaltLen = 0;
+    uint8_t mVerifier[chip::Crypto::kSpake2p_VerifierSerialized_Length];
+    size_t mVerifierLen = 0;
+    // Passcode the cached verifier was generated for
+    uint32_t mVerifierPasscode = 0;
 };